@@ -0,0 +1,513 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Urho3DAll.h>
+#include <Toolbox/Common/UndoManager.h>
+#include <Toolbox/IO/ContentUtilities.h>
+#include <Toolbox/IO/ResourceSearchIndex.h>
+#include <Toolbox/SystemUI/AttributeInspector.h>
+#include <Toolbox/SystemUI/ImGuiDock.h>
+#include <Toolbox/SystemUI/ResourceBrowser.h>
+#include <Toolbox/SystemUI/SystemUI.h>
+#include <Toolbox/SystemUI/Widgets.h>
+
+
+namespace Urho3D
+{
+
+/// Measurement of a single benchmark.
+struct BenchmarkResult
+{
+    /// Benchmark name.
+    String name_;
+    /// Number of operations performed.
+    unsigned operations_;
+    /// Time it took to perform all operations.
+    long long microseconds_;
+};
+
+/// Runs engine headless and measures performance of Toolbox subsystems. Results are written as JSON to standard
+/// output or to a file specified by -output argument.
+///
+/// Arguments:
+///   -nodes N       number of nodes in synthetic scenes
+///   -steps N       number of undo steps
+///   -files N       number of synthetic resource files
+///   -docks N       number of docks in synthetic layout
+///   -folder N      number of files in synthetic folder shown in resource browser
+///   -iterations N  number of repetitions of every benchmark
+///   -output FILE   file results are written to
+class ToolboxBenchmarks : public Application
+{
+    URHO3D_OBJECT(ToolboxBenchmarks, Application);
+public:
+    explicit ToolboxBenchmarks(Context* context)
+        : Application(context)
+    {
+    }
+
+    void Setup() override
+    {
+        engineParameters_[EP_HEADLESS] = true;
+        engineParameters_[EP_SOUND] = false;
+        engineParameters_[EP_LOG_QUIET] = true;
+        engineParameters_[EP_LOG_NAME] = "";
+        engineParameters_[EP_RESOURCE_PATHS] = "";
+        engineParameters_[EP_RESOURCE_PREFIX_PATHS] = "";
+
+        const auto& arguments = GetArguments();
+        for (unsigned i = 0; i + 1 < arguments.Size(); i++)
+        {
+            const String& argument = arguments[i];
+            if (argument == "-nodes")
+                numNodes_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-steps")
+                numSteps_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-files")
+                numFiles_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-docks")
+                numDocks_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-folder")
+                numFolderFiles_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-iterations")
+                iterations_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-output")
+                outputPath_ = arguments[++i];
+        }
+    }
+
+    void Start() override
+    {
+        InitializeUI();
+
+        BenchmarkStates();
+        BenchmarkUndo();
+        BenchmarkContent();
+        BenchmarkInspector();
+        BenchmarkUIState();
+        BenchmarkDock();
+        BenchmarkResourceBrowser();
+
+        WriteResults();
+        engine_->Exit();
+    }
+
+    /// Prepare ImGui for rendering frames without a graphics subsystem.
+    void InitializeUI()
+    {
+        auto& io = ui::GetIO();
+        io.IniFilename = nullptr;
+        io.DisplaySize = ImVec2(1920, 1080);
+        io.DeltaTime = 1.0f / 60.0f;
+
+        unsigned char* pixels;
+        int width, height;
+        io.Fonts->AddFontDefault();
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+        io.Fonts->ClearTexData();
+    }
+
+    /// Create scene consisting of nodes arranged in a tree, every node having a few components.
+    SharedPtr<Scene> CreateScene()
+    {
+        SharedPtr<Scene> scene(new Scene(context_));
+        scene->CreateComponent<Octree>();
+
+        PODVector<Node*> nodes;
+        for (unsigned i = 0; i < numNodes_; i++)
+        {
+            Node* parent = i < 8 ? scene.Get() : nodes[i / 8 - 1];
+            Node* node = parent->CreateChild(ToString("Node %u", i));
+            node->SetPosition(Vector3((float)i, 0, 0));
+            node->CreateComponent<Light>();
+            node->CreateComponent<Camera>();
+            nodes.Push(node);
+        }
+        return scene;
+    }
+
+    /// Run function once and record how long it took.
+    template<typename F>
+    void Measure(const String& name, unsigned operations, F function)
+    {
+        HiresTimer timer;
+        function();
+        results_.Push({name, operations, timer.GetUSec(false)});
+    }
+
+    /// Measure identification and comparison of undo states.
+    void BenchmarkStates()
+    {
+        const unsigned numComparisons = 1000000;
+
+        SharedPtr<Scene> scene = CreateScene();
+        PODVector<Node*> nodes;
+        scene->GetChildren(nodes, true);
+
+        Undo::ValuePool pool;
+        Vector<SharedPtr<Undo::State>> states;
+        for (Node* node : nodes)
+        {
+            states.Push(SharedPtr<Undo::State>(new Undo::AttributeState(&pool, node, "Position", node->GetPosition())));
+            states.Push(SharedPtr<Undo::State>(new Undo::NodeParentState(node, node->GetParent())));
+        }
+
+        Measure("UndoStateCastRTTI", numComparisons, [&]() {
+            for (unsigned i = 0, j = 0; i < numComparisons; i++, j = j + 1 < states.Size() ? j + 1 : 0)
+                sink_ += dynamic_cast<Undo::AttributeState*>(states[j].Get()) != nullptr ? 1 : 0;
+        });
+        Measure("UndoStateCastTag", numComparisons, [&]() {
+            for (unsigned i = 0, j = 0; i < numComparisons; i++, j = j + 1 < states.Size() ? j + 1 : 0)
+                sink_ += states[j]->Cast<Undo::AttributeState>() != nullptr ? 1 : 0;
+        });
+        Measure("UndoStateEquals", numComparisons, [&]() {
+            for (unsigned i = 0, j = 0; i < numComparisons; i++, j = j + 1 < states.Size() ? j + 1 : 0)
+                sink_ += states[j]->Equals(states[states.Size() - 1 - j]) ? 1 : 0;
+        });
+    }
+
+    /// Measure commit, undo and redo of attribute changes of every node in the scene.
+    void BenchmarkUndo()
+    {
+        SharedPtr<Scene> scene = CreateScene();
+        PODVector<Node*> nodes;
+        scene->GetChildren(nodes, true);
+
+        Undo::Manager undo(context_);
+        undo.Connect(scene);
+
+        Measure("UndoCommit", numSteps_, [&]() {
+            for (unsigned step = 0; step < numSteps_; step++)
+            {
+                Undo::Group group(undo);
+                for (Node* node : nodes)
+                {
+                    Vector3 oldPosition = node->GetPosition();
+                    node->SetPosition(oldPosition + Vector3::ONE);
+                    undo.TrackState(node, "Position", node->GetPosition(), oldPosition);
+                }
+            }
+        });
+        Measure("UndoUndo", numSteps_, [&]() {
+            for (unsigned step = 0; step < numSteps_; step++)
+                undo.Undo();
+        });
+        Measure("UndoRedo", numSteps_, [&]() {
+            for (unsigned step = 0; step < numSteps_; step++)
+                undo.Redo();
+        });
+    }
+
+    /// Measure detection of file and content types of resource files.
+    void BenchmarkContent()
+    {
+        static const char* rootTags[] = {"scene", "node", "material", "element", "elements", "particleeffect",
+            "renderpath", "texture"};
+        static const char* extensions[] = {".mdl", ".ani", ".png", ".ogg", ".txt"};
+
+        auto fs = GetSubsystem<FileSystem>();
+        auto cache = GetSubsystem<ResourceCache>();
+        String resourceDir = fs->GetTemporaryDir() + "ToolboxBenchmarks/";
+        fs->CreateDir(resourceDir);
+
+        Vector<String> fileNames;
+        for (unsigned i = 0; i < numFiles_; i++)
+        {
+            String fileName;
+            if (i % 2 == 0)
+            {
+                fileName = ToString("File%u.xml", i);
+                XMLFile xml(context_);
+                XMLElement root = xml.CreateRoot(rootTags[i / 2 % 8]);
+                for (unsigned j = 0; j < 64; j++)
+                    root.CreateChild("attribute").SetAttribute("value", ToString("%u", j));
+                xml.SaveFile(resourceDir + fileName);
+            }
+            else
+            {
+                fileName = ToString("File%u%s", i, extensions[i / 2 % 5]);
+                File file(context_, resourceDir + fileName, FILE_WRITE);
+                for (unsigned j = 0; j < 1024; j++)
+                    file.WriteUInt(j);
+            }
+            fileNames.Push(fileName);
+        }
+        cache->AddResourceDir(resourceDir);
+
+        Measure("GetFileType", numFiles_ * iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                for (const auto& fileName : fileNames)
+                    sink_ += GetFileType(fileName);
+            }
+        });
+        Measure("GetContentTypeCold", numFiles_ * iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                ClearContentTypeCache();
+                for (const auto& fileName : fileNames)
+                    sink_ += GetContentType(context_, fileName);
+            }
+        });
+        Measure("GetContentTypeCached", numFiles_ * iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                for (const auto& fileName : fileNames)
+                    sink_ += GetContentType(context_, fileName);
+            }
+        });
+
+        cache->ReleaseAllResources(true);
+        cache->RemoveResourceDir(resourceDir);
+        for (const auto& fileName : fileNames)
+            fs->Delete(resourceDir + fileName);
+    }
+
+    /// Measure rendering of attribute inspector for every node and component in the scene.
+    void BenchmarkInspector()
+    {
+        SharedPtr<Scene> scene = CreateScene();
+        PODVector<Node*> nodes;
+        scene->GetChildren(nodes, true);
+
+        PODVector<Serializable*> items;
+        for (Node* node : nodes)
+        {
+            items.Push(node);
+            for (Component* component : node->GetComponents())
+                items.Push(component);
+        }
+
+        AttributeInspector inspector(context_);
+        Measure("AttributeInspectorRender", items.Size() * iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                ui::NewFrame();
+                if (ui::Begin("Inspector"))
+                    inspector.RenderAttributes(items);
+                ui::End();
+                ui::Render();
+            }
+        });
+    }
+
+    /// Measure retrieval of many ui states every frame.
+    void BenchmarkUIState()
+    {
+        const unsigned numStates = 10000;
+
+        struct State
+        {
+            unsigned value_ = 0;
+        };
+
+        Measure("UIStateGet", numStates * iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                ui::NewFrame();
+                ui::Begin("UIState");
+                for (unsigned j = 0; j < numStates; j++)
+                {
+                    ui::PushID(j);
+                    sink_ += ui::GetUIState<State>()->value_++;
+                    ui::PopID();
+                }
+                ui::End();
+                ui::Render();
+            }
+        });
+
+        ui::NewFrame();
+        ui::Begin("UIState");
+        ui::ExpireUIStateWindow(ui::GetCurrentWindow()->ID);
+        ui::End();
+        ui::Render();
+    }
+
+    /// Measure saving and loading of dock layout.
+    void BenchmarkDock()
+    {
+        Vector<String> labels;
+        for (unsigned i = 0; i < numDocks_; i++)
+            labels.Push(ToString("Dock %u", i));
+
+        // Docks are placed over couple of frames.
+        for (unsigned frame = 0; frame < 2; frame++)
+        {
+            ui::NewFrame();
+            ui::RootDock({0, 0}, ui::GetIO().DisplaySize);
+            for (unsigned i = 0; i < labels.Size(); i++)
+            {
+                if (i > 0)
+                {
+                    ui::DockSlot_ slot = i % 3 == 0 ? ui::Slot_Tab : (i % 3 == 1 ? ui::Slot_Right : ui::Slot_Bottom);
+                    ui::SetNextDockPos(labels[i - 1].CString(), slot, ImGuiCond_FirstUseEver);
+                }
+                ui::BeginDock(labels[i].CString());
+                ui::EndDock();
+            }
+            ui::Render();
+        }
+
+        XMLFile xml(context_);
+        XMLElement docks = xml.CreateRoot("docks");
+        Measure("DockSave", iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                docks.RemoveChildren();
+                ui::SaveDock(docks);
+            }
+        });
+        Measure("DockLoad", iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+                ui::LoadDock(docks);
+        });
+
+        ui::ShutdownDock();
+    }
+
+    /// Measure rendering of resource browser showing a folder with many files and searching it.
+    void BenchmarkResourceBrowser()
+    {
+        auto fs = GetSubsystem<FileSystem>();
+        auto cache = GetSubsystem<ResourceCache>();
+        String resourceDir = fs->GetTemporaryDir() + "ToolboxBenchmarksFolder/";
+        fs->CreateDir(resourceDir);
+
+        Vector<String> fileNames;
+        for (unsigned i = 0; i < numFolderFiles_; i++)
+        {
+            fileNames.Push(ToString("File%u.xml", i));
+            File file(context_, resourceDir + fileNames.Back(), FILE_WRITE);
+        }
+        cache->AddResourceDir(resourceDir);
+
+        String selected;
+        auto renderFrame = [&]() {
+            ui::NewFrame();
+            ui::RootDock({0, 0}, ui::GetIO().DisplaySize);
+            ResourceBrowserWindow(context_, selected, nullptr);
+            ui::Render();
+        };
+
+        // First frame scans the folder.
+        Measure("ResourceBrowserFirstFrame", 1, renderFrame);
+        Measure("ResourceBrowserFrame", iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+                renderFrame();
+        });
+
+        SharedPtr<ResourceSearchIndex> index(new ResourceSearchIndex(context_));
+        Measure("ResourceSearchBuild", numFolderFiles_, [&]() {
+            index->Rebuild();
+            GetSubsystem<WorkQueue>()->Complete(0);
+            SendEvent(E_BEGINFRAME);
+        });
+        ResourceSearch search;
+        Measure("ResourceSearchPrefix", iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                search = ResourceSearch();
+                index->BeginSearch(search, ToString("File%u", i % numFolderFiles_));
+            }
+        });
+        Measure("ResourceSearchFuzzy", iterations_, [&]() {
+            for (unsigned i = 0; i < iterations_; i++)
+            {
+                search = ResourceSearch();
+                index->BeginSearch(search, ToString("fe%ux", i % numFolderFiles_));
+                index->UpdateSearch(search, M_MAX_UNSIGNED);
+            }
+        });
+        index.Reset();
+
+        ui::ShutdownDock();
+        cache->RemoveResourceDir(resourceDir);
+        for (const auto& fileName : fileNames)
+            fs->Delete(resourceDir + fileName);
+    }
+
+    /// Write results to standard output or to a file.
+    void WriteResults()
+    {
+        JSONFile json(context_);
+        JSONValue& root = json.GetRoot();
+        root.Set("timestamp", Time::GetTimeStamp().Trimmed());
+
+        JSONValue config;
+        config.Set("nodes", numNodes_);
+        config.Set("steps", numSteps_);
+        config.Set("files", numFiles_);
+        config.Set("docks", numDocks_);
+        config.Set("folder", numFolderFiles_);
+        config.Set("iterations", iterations_);
+        root.Set("config", config);
+
+        JSONValue results;
+        for (const auto& result : results_)
+        {
+            JSONValue entry;
+            entry.Set("name", result.name_);
+            entry.Set("operations", result.operations_);
+            entry.Set("totalMs", result.microseconds_ / 1000.0);
+            entry.Set("nsPerOperation", result.operations_ > 0 ? result.microseconds_ * 1000.0 / result.operations_ : 0.0);
+            results.Push(entry);
+        }
+        root.Set("results", results);
+
+        if (outputPath_.Empty())
+        {
+            VectorBuffer buffer;
+            json.Save(buffer, "  ");
+            PrintLine(String((const char*)buffer.GetData(), buffer.GetSize()));
+        }
+        else if (!json.SaveFile(outputPath_))
+        {
+            PrintLine("Saving results to " + outputPath_ + " failed", true);
+            exitCode_ = EXIT_FAILURE;
+        }
+    }
+
+protected:
+    /// Number of nodes in synthetic scenes.
+    unsigned numNodes_ = 1000;
+    /// Number of undo steps.
+    unsigned numSteps_ = 100;
+    /// Number of synthetic resource files.
+    unsigned numFiles_ = 500;
+    /// Number of docks in synthetic layout.
+    unsigned numDocks_ = 16;
+    /// Number of files in synthetic folder shown in resource browser.
+    unsigned numFolderFiles_ = 20000;
+    /// Number of repetitions of every benchmark.
+    unsigned iterations_ = 100;
+    /// File results are written to. Empty means standard output.
+    String outputPath_;
+    /// Measurements.
+    Vector<BenchmarkResult> results_;
+    /// Accumulates results of measured operations so they are not optimized away.
+    volatile unsigned sink_ = 0;
+};
+
+}
+
+URHO3D_DEFINE_APPLICATION_MAIN(Urho3D::ToolboxBenchmarks);
@@ -25,7 +25,12 @@
 #include "EditorIconCache.h"
 #include "Editor/Tabs/Scene/SceneTab.h"
 #include "Editor/Tabs/Scene/SceneSettings.h"
+#include <Toolbox/Graphics/ThumbnailService.h>
 #include <Toolbox/IO/ContentUtilities.h>
+#include <Toolbox/IO/ResourceDependencyGraph.h>
+#include <Toolbox/IO/ResourcePreloader.h>
+#include <Toolbox/IO/ResourceSaver.h>
+#include <Toolbox/IO/ResourceSearchIndex.h>
 #include <Toolbox/SystemUI/ResourceBrowser.h>
 #include <Toolbox/SystemUI/Widgets.h>
 #include <Toolbox/Toolbox.h>
@@ -40,6 +45,9 @@ URHO3D_DEFINE_APPLICATION_MAIN(Editor);
 namespace Urho3D
 {
 
+/// Time in milliseconds without input that has to pass before frame rate is lowered.
+static const unsigned IDLE_DELAY_MS = 500;
+
 Editor::Editor(Context* context)
     : Application(context)
 {
@@ -91,15 +99,38 @@ void Editor::Start()
     SceneSettings::RegisterObject(context_);
 
     GetSubsystem<SystemUI>()->ApplyStyleDefault(true, 1.0f);
+    GetSubsystem<SystemUI>()->SetFontAtlasCachePath(
+        GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "Editor") + "FontAtlas.cache");
     GetSubsystem<SystemUI>()->AddFont("Fonts/fontawesome-webfont.ttf", 0, {ICON_MIN_FA, ICON_MAX_FA, 0}, true);
     ui::GetStyle().WindowRounding = 3;
     // Disable imgui saving ui settings on it's own. These should be serialized to project file.
     ui::GetIO().IniFilename = nullptr;
 
     GetSubsystem<ResourceCache>()->SetAutoReloadResources(true);
+    LoadContentTypeCache(context_, GetContentTypeCachePath());
+
+    auto thumbnails = new ThumbnailService(context_);
+    thumbnails->SetCacheDir(GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "Editor") + "Thumbnails/");
+    context_->RegisterSubsystem(thumbnails);
+    // Resource directories are indexed in background, so that search is ready by the time it is needed.
+    context_->RegisterSubsystem(new ResourceSearchIndex(context_));
+    auto dependencies = new ResourceDependencyGraph(context_);
+    dependencies->Load(GetDependencyGraphPath());
+    context_->RegisterSubsystem(dependencies);
+    context_->RegisterSubsystem(new ResourcePreloader(context_));
+    // Resources edited in inspector are saved in background once user stops changing them.
+    context_->RegisterSubsystem(new ResourceSaver(context_));
 
     SubscribeToEvent(E_UPDATE, std::bind(&Editor::OnUpdate, this, _2));
 
+    // Frame rate is lowered while ui does not change and nothing happens. Input or changes of scene structure or
+    // resources restore it.
+    GetSubsystem<SystemUI>()->SetSkipUnchangedFrames(true);
+    maxFps_ = GetSubsystem<Engine>()->GetMaxFps();
+    for (StringHash event : {E_SDLRAWINPUT, E_NODEADDED, E_NODEREMOVED, E_COMPONENTADDED, E_COMPONENTREMOVED,
+        E_FILECHANGED})
+        SubscribeToEvent(event, [&](StringHash, VariantMap&) { activityTimer_.Reset(); });
+
     LoadProject("Etc/DefaultEditorProject.xml");
     // Prevent overwriting example scene.
     DynamicCast<SceneTab>(tabs_.Front())->ClearCachedPaths();
@@ -108,9 +139,22 @@ void Editor::Start()
 void Editor::Stop()
 {
     SaveProject(projectFilePath_);
+    GetSubsystem<ResourceSaver>()->Flush(true);
+    SaveContentTypeCache(context_, GetContentTypeCachePath());
+    GetSubsystem<ResourceDependencyGraph>()->Save(GetDependencyGraphPath());
     ui::ShutdownDock();
 }
 
+String Editor::GetContentTypeCachePath() const
+{
+    return GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "Editor") + "ContentTypes.cache";
+}
+
+String Editor::GetDependencyGraphPath() const
+{
+    return GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "Editor") + "Dependencies.cache";
+}
+
 void Editor::SaveProject(const String& filePath)
 {
     if (filePath.Empty())
@@ -249,6 +293,15 @@ void Editor::OnUpdate(VariantMap& args)
         else if (type == CTYPE_UILAYOUT)
             CreateNewTab<UITab>()->LoadResource(selected);
     }
+
+    UpdateFrameRate();
+}
+
+void Editor::UpdateFrameRate()
+{
+    // Delay gives ui animations, like fading of tooltips, time to finish after last input.
+    bool idle = GetSubsystem<SystemUI>()->IsIdle() && activityTimer_.GetMSec(false) >= IDLE_DELAY_MS;
+    GetSubsystem<Engine>()->SetMaxFps(idle ? idleMaxFps_ : maxFps_);
 }
 
 void Editor::RenderMenuBar()
@@ -69,6 +69,14 @@ public:
     StringVector GetObjectCategories() const;
     /// Return a map of names and type hashes from specified category.
     StringVector GetObjectsByCategory(const String& category);
+    /// Return path of a file storing content types of resource files between sessions.
+    String GetContentTypeCachePath() const;
+    /// Return path of a file storing resource dependency graph between sessions.
+    String GetDependencyGraphPath() const;
+    /// Set maximum frame rate used while user is idle and nothing changes.
+    void SetIdleMaxFps(unsigned fps) { idleMaxFps_ = fps; }
+    /// Return maximum frame rate used while user is idle and nothing changes.
+    unsigned GetIdleMaxFps() const { return idleMaxFps_; }
 
 protected:
     /// Pool tracking availability of unique IDs used by editor.
@@ -81,6 +89,15 @@ protected:
     String projectFilePath_;
     /// Flag which opens resource browser window.
     bool resourceBrowserWindowOpen_ = true;
+    /// Maximum frame rate while editor is in use.
+    unsigned maxFps_ = 0;
+    /// Maximum frame rate while user is idle and nothing changes.
+    unsigned idleMaxFps_ = 10;
+    /// Time since last input or change of scene structure or resources.
+    Timer activityTimer_;
+
+    /// Lower frame rate while user is idle and nothing changes, restore it otherwise.
+    void UpdateFrameRate();
 };
 
 }
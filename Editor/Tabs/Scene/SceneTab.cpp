@@ -41,6 +41,7 @@ SceneTab::SceneTab(Context* context, StringHash id, const String& afterDockName,
     , view_(context, {0, 0, 1024, 768})
     , gizmo_(context)
     , undo_(context)
+    , journal_(context)
 {
     SetTitle("New Scene");
     windowFlags_ = ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse;
@@ -52,6 +53,10 @@ SceneTab::SceneTab(Context* context, StringHash id, const String& afterDockName,
     SubscribeToEvent(effectSettings_, E_EDITORSCENEEFFECTSCHANGED, std::bind(&AttributeInspector::CopyEffectsFrom,
         &inspector_, view_.GetViewport()));
 
+    undo_.SetMemoryBudget(64 * 1024 * 1024);
+    undo_.SetCoalesceInterval(250);
+    undo_.SetCoalesceWhileActive(true);
+    undo_.SetJournal(&journal_);
     undo_.Connect(view_.GetScene());
     undo_.Connect(&inspector_);
     undo_.Connect(&gizmo_);
@@ -59,6 +64,16 @@ SceneTab::SceneTab(Context* context, StringHash id, const String& afterDockName,
     SubscribeToEvent(view_.GetScene(), E_ASYNCLOADFINISHED, [&](StringHash, VariantMap&) {
         undo_.Clear();
     });
+
+    // Attributes inspected when multiple nodes are selected depend on their components.
+    auto invalidateInspectorGroups = [&](StringHash, VariantMap&) { inspectorGroupsDirty_ = true; };
+    SubscribeToEvent(view_.GetScene(), E_COMPONENTADDED, invalidateInspectorGroups);
+    SubscribeToEvent(view_.GetScene(), E_COMPONENTREMOVED, invalidateInspectorGroups);
+    SubscribeToEvent(view_.GetScene(), E_NODEREMOVED, invalidateInspectorGroups);
+
+    // Tabs loaded from a project receive their ID later.
+    if (id_ != StringHash::ZERO)
+        journal_.Open(GetJournalPath(), String::EMPTY);
 }
 
 SceneTab::~SceneTab() = default;
@@ -160,6 +175,7 @@ void SceneTab::LoadResource(const String& resourcePath)
         {
             path_ = resourcePath;
             CreateObjects();
+            journal_.Open(GetJournalPath(), path_);
         }
         else
             URHO3D_LOGERRORF("Loading scene %s failed", GetFileName(resourcePath).CString());
@@ -170,6 +186,7 @@ void SceneTab::LoadResource(const String& resourcePath)
         {
             path_ = resourcePath;
             CreateObjects();
+            journal_.Open(GetJournalPath(), path_);
         }
         else
             URHO3D_LOGERRORF("Loading scene %s failed", GetFileName(resourcePath).CString());
@@ -209,6 +226,8 @@ bool SceneTab::SaveResource(const String& resourcePath)
             path_ = resourcePath;
             SetTitle(GetFileName(path_));
         }
+        // Saved changes need no recovery.
+        journal_.Open(GetJournalPath(), path_);
     }
     else
         URHO3D_LOGERRORF("Saving scene to %s failed.", resourcePath.CString());
@@ -332,8 +351,13 @@ void SceneTab::OnNodeSelectionChanged()
 
 void SceneTab::RenderInspector()
 {
-    // TODO: inspector for multi-selection.
-    if (GetSelection().Size() == 1)
+    if (GetSelection().Size() > 1)
+    {
+        if (inspectorGroupsDirty_ || inspectedSelection_ != GetSelection())
+            UpdateInspectorGroups();
+        inspector_.RenderAttributes(inspectorGroups_);
+    }
+    else if (GetSelection().Size() == 1)
     {
         auto node = GetSelection().Front();
         PODVector<Serializable*> items;
@@ -350,6 +374,71 @@ void SceneTab::RenderInspector()
     }
 }
 
+void SceneTab::UpdateInspectorGroups()
+{
+    inspectedSelection_ = GetSelection();
+    inspectorGroupsDirty_ = false;
+    inspectorGroups_.Clear();
+
+    PODVector<Node*> nodes;
+    for (const auto& node : inspectedSelection_)
+    {
+        if (!node.Expired())
+            nodes.Push(node.Get());
+    }
+    if (nodes.Empty())
+        return;
+
+    // Nodes are grouped by type, because scene has attributes of it's own.
+    HashMap<StringHash, unsigned> groupIndices;
+    for (Node* node : nodes)
+    {
+        StringHash type = node->GetType();
+        if (!groupIndices.Contains(type))
+        {
+            groupIndices[type] = inspectorGroups_.Size();
+            inspectorGroups_.Resize(inspectorGroups_.Size() + 1);
+        }
+        inspectorGroups_[groupIndices[type]].Push(node);
+    }
+
+    // Components are inspected only when every selected node has a component of that type. All components of that
+    // type are edited together.
+    HashMap<StringHash, unsigned> numNodesWithType;
+    PODVector<StringHash> nodeTypes;
+    for (Node* node : nodes)
+    {
+        nodeTypes.Clear();
+        for (Component* component : node->GetComponents())
+        {
+            if (!nodeTypes.Contains(component->GetType()))
+                nodeTypes.Push(component->GetType());
+        }
+        for (StringHash type : nodeTypes)
+            numNodesWithType[type]++;
+    }
+
+    for (Component* component : nodes.Front()->GetComponents())
+    {
+        StringHash type = component->GetType();
+        if (numNodesWithType[type] != nodes.Size())
+            continue;
+        // Group of this type is created only once.
+        numNodesWithType[type] = 0;
+
+        PODVector<Serializable*> group;
+        for (Node* node : nodes)
+        {
+            for (Component* nodeComponent : node->GetComponents())
+            {
+                if (nodeComponent->GetType() == type)
+                    group.Push(nodeComponent);
+            }
+        }
+        inspectorGroups_.Push(group);
+    }
+}
+
 void SceneTab::RenderNodeTree()
 {
     auto oldSpacing = ui::GetStyle().IndentSpacing;
@@ -503,7 +592,15 @@ void SceneTab::RenderNodeTree(Node* node)
 void SceneTab::LoadProject(XMLElement& scene)
 {
     id_ = StringHash(ToUInt(scene.GetAttribute("id"), 16));
+
+    // Journal is read before loading resource, because loading starts a new journal.
+    String journalResource;
+    Vector<PODVector<unsigned char>> journalRecords;
+    Undo::Journal::Read(context_, GetJournalPath(), journalResource, journalRecords);
+
     LoadResource(scene.GetAttribute("path"));
+    if (!journal_.IsOpen())
+        journal_.Open(GetJournalPath(), path_);
 
     auto camera = scene.GetChild("camera");
     if (camera.NotNull())
@@ -521,6 +618,12 @@ void SceneTab::LoadProject(XMLElement& scene)
     effectSettings_->LoadProject(scene);
 
     undo_.Clear();
+
+    if (!journalRecords.Empty() && journalResource == path_)
+    {
+        undo_.Recover(journalRecords);
+        URHO3D_LOGINFOF("Recovered %u unsaved changes of scene %s.", journalRecords.Size(), GetTitle().CString());
+    }
 }
 
 void SceneTab::SaveProject(XMLElement& scene)
@@ -566,6 +669,7 @@ void SceneTab::OnActiveUpdate()
 
 void SceneTab::RemoveSelection()
 {
+    Undo::Group group(undo_);
     if (!selectedComponent_.Expired())
     {
         selectedComponent_->Remove();
@@ -574,7 +678,16 @@ void SceneTab::RemoveSelection()
     else
     {
         for (auto& selected : GetSelection())
-            selected->Remove();
+        {
+            // Removing a node removes it's children as well, therefore only topmost selected nodes are removed.
+            bool ancestorSelected = false;
+            for (Node* parent = selected->GetParent(); parent != nullptr && !ancestorSelected;
+                parent = parent->GetParent())
+                ancestorSelected = IsSelected(parent);
+
+            if (!ancestorSelected)
+                selected->Remove();
+        }
         UnselectAll();
     }
 }
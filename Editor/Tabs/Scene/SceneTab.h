@@ -30,6 +30,7 @@
 #include <Toolbox/SystemUI/ImGuiDock.h>
 #include <Toolbox/Graphics/SceneView.h>
 #include <Toolbox/Common/UndoManager.h>
+#include <Toolbox/Common/UndoJournal.h>
 #include "Editor/IDPool.h"
 #include "Editor/Tabs/Tab.h"
 
@@ -92,6 +93,8 @@ protected:
     void CreateObjects();
     /// Render content of the tab window.
     bool RenderWindowContent() override;
+    /// Group selected nodes and their components for inspecting attributes of multiple nodes at once.
+    void UpdateInspectorGroups();
 
     /// Scene renderer.
     SceneView view_;
@@ -107,6 +110,14 @@ protected:
     SharedPtr<SceneEffects> effectSettings_;
     /// State change tracker.
     Undo::Manager undo_;
+    /// On-disk log of changes used for recovering unsaved changes.
+    Undo::Journal journal_;
+    /// Selection for which inspector groups were built.
+    Vector<WeakPtr<Node>> inspectedSelection_;
+    /// Groups of selected nodes and components whose attributes are inspected together.
+    Vector<PODVector<Serializable*>> inspectorGroups_;
+    /// Flag indicating that components of selected nodes may have changed.
+    bool inspectorGroupsDirty_ = true;
 };
 
 };
@@ -21,6 +21,8 @@
 //
 
 #include <Urho3D/Input/Input.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Toolbox/SystemUI/Widgets.h>
 #include "Tab.h"
 
 
@@ -51,6 +53,11 @@ bool Tab::RenderWindow()
     {
         if (open)
         {
+            // Tab is rendered in a different window when it is docked and when it is floating.
+            ImGuiID windowId = ui::GetCurrentWindow()->ID;
+            if (!windowIds_.Contains(windowId))
+                windowIds_.Push(windowId);
+
             IntRect tabRect = ToIntRect(ui::GetCurrentWindow()->InnerRect);
             if (tabRect.IsInside(lastMousePosition_) == INSIDE)
             {
@@ -77,6 +84,14 @@ bool Tab::RenderWindow()
     }
     ui::EndDock();
 
+    // Closed tab will not use it's ui state anymore.
+    if (!open)
+    {
+        for (ImGuiID windowId : windowIds_)
+            ui::ExpireUIStateWindow(windowId);
+        windowIds_.Clear();
+    }
+
     return open;
 }
 
@@ -86,4 +101,12 @@ void Tab::SetTitle(const String& title)
     uniqueTitle_ = ToString("%s###%s", title.CString(), id_.ToString().CString());
 }
 
+String Tab::GetJournalPath() const
+{
+    auto fs = GetSubsystem<FileSystem>();
+    String journalDir = fs->GetAppPreferencesDir("urho3d", "Editor") + "Journal/";
+    fs->CreateDir(journalDir);
+    return journalDir + id_.ToString() + ".journal";
+}
+
 }
@@ -76,6 +76,8 @@ public:
     bool IsRendered() const { return isRendered_; }
     /// Return unuque object id.
     StringHash GetID() const { return id_; }
+    /// Return path of undo journal file of this tab.
+    String GetJournalPath() const;
 
 protected:
     /// Unique scene id.
@@ -98,6 +100,8 @@ protected:
     ui::DockSlot_ placePosition_;
     /// Last known mouse position when it was visible.
     IntVector2 lastMousePosition_;
+    /// Windows tab contents were rendered in.
+    PODVector<ImGuiID> windowIds_;
 };
 
 }
@@ -38,6 +38,7 @@ UITab::UITab(Urho3D::Context* context, Urho3D::StringHash id, const Urho3D::Stri
     ui::DockSlot_ position)
     : Tab(context, id, afterDockName, position)
     , undo_(context)
+    , journal_(context)
 {
     SetTitle("New UI Layout");
     windowFlags_ = ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse;
@@ -55,13 +56,34 @@ UITab::UITab(Urho3D::Context* context, Urho3D::StringHash id, const Urho3D::Stri
     // Prevents crashes due to uninitialized texture.
     UpdateViewRect({0, 0, 512, 512});
 
+    undo_.SetMemoryBudget(16 * 1024 * 1024);
+    undo_.SetCoalesceInterval(250);
+    undo_.SetCoalesceWhileActive(true);
+    undo_.SetJournal(&journal_);
     undo_.Connect(rootElement_);
     undo_.Connect(&inspector_);
 
     SubscribeToEvent(E_ATTRIBUTEINSPECTORMENU, std::bind(&UITab::AttributeMenu, this, _2));
     SubscribeToEvent(E_ATTRIBUTEINSPECTOATTRIBUTE, std::bind(&UITab::AttributeCustomize, this, _2));
+    // Attribute customization depends on contents of style file.
+    SubscribeToEvent(E_FILECHANGED, [&](StringHash, VariantMap& args) {
+        const String& resourceName = args[FileChanged::P_RESOURCENAME].GetString();
+        for (UIElement* element : {static_cast<UIElement*>(rootElement_.Get()), selectedElement_.Get()})
+        {
+            XMLFile* styleFile = element != nullptr ? element->GetDefaultStyle() : nullptr;
+            if (styleFile != nullptr && styleFile->GetName() == resourceName)
+            {
+                inspector_.InvalidateCustomization();
+                break;
+            }
+        }
+    });
 
     AutoLoadDefaultStyle();
+
+    // Tabs loaded from a project receive their ID later.
+    if (id_ != StringHash::ZERO)
+        journal_.Open(GetJournalPath(), String::EMPTY);
 }
 
 void UITab::RenderNodeTree()
@@ -193,15 +215,22 @@ bool UITab::RenderWindowContent()
 
 void UITab::RenderToolbarButtons()
 {
+    // Undo may change style, which affects attribute customization.
     if (ui::Button(ICON_FA_UNDO))
+    {
         undo_.Undo();
+        inspector_.InvalidateCustomization();
+    }
 
     if (ui::IsItemHovered())
-        ui::SetTooltip("Undo.");
+        ui::SetTooltip("Undo.\nHistory: %u steps, %u KB", undo_.GetNumEntries(), undo_.GetMemoryUse() / 1024);
     ui::SameLine();
 
     if (ui::Button(ICON_FA_REPEAT))
+    {
         undo_.Redo();
+        inspector_.InvalidateCustomization();
+    }
 
     if (ui::IsItemHovered())
         ui::SetTooltip("Redo.");
@@ -224,9 +253,15 @@ void UITab::OnActiveUpdate()
         if (input->GetKeyDown(KEY_CTRL))
         {
             if (input->GetKeyPress(KEY_Y) || (input->GetKeyDown(KEY_SHIFT) && input->GetKeyPress(KEY_Z)))
+            {
                 undo_.Redo();
+                inspector_.InvalidateCustomization();
+            }
             else if (input->GetKeyPress(KEY_Z))
+            {
                 undo_.Undo();
+                inspector_.InvalidateCustomization();
+            }
         }
 
         if (auto selected = GetSelected())
@@ -295,13 +330,7 @@ void UITab::LoadResource(const String& resourcePath)
         {
             child->SetStyleAuto();
             SetTitle(GetFileName(resourcePath));
-
-            // Must be disabled because it interferes with ui element resizing
-            if (auto window = dynamic_cast<Window*>(child))
-            {
-                window->SetMovable(false);
-                window->SetResizable(false);
-            }
+            PrepareLayout(child);
 
             path_ = resourcePath;
 
@@ -309,6 +338,7 @@ void UITab::LoadResource(const String& resourcePath)
                 oldChild->Remove();
 
             undo_.Clear();
+            journal_.Open(GetJournalPath(), path_);
         }
         else
         {
@@ -370,6 +400,9 @@ bool UITab::SaveResource(const String& resourcePath)
     if (!path_.Empty())
         SetTitle(GetFileName(path_));
 
+    // Saved changes need no recovery.
+    journal_.Open(GetJournalPath(), path_);
+
     return true;
 }
 
@@ -424,6 +457,16 @@ void UITab::AutoLoadDefaultStyle()
     Sort(styleNames_.Begin(), styleNames_.End());
 }
 
+void UITab::PrepareLayout(UIElement* layout)
+{
+    // Must be disabled because it interferes with ui element resizing
+    if (auto window = dynamic_cast<Window*>(layout))
+    {
+        window->SetMovable(false);
+        window->SetResizable(false);
+    }
+}
+
 void UITab::RenderElementContextMenu()
 {
     if (ui::BeginPopup("Element Context Menu"))
@@ -493,7 +536,24 @@ void UITab::SaveProject(XMLElement& tab)
 void UITab::LoadProject(XMLElement& tab)
 {
     id_ = StringHash(ToUInt(tab.GetAttribute("id"), 16));
+
+    // Journal is read before loading resource, because loading starts a new journal.
+    String journalResource;
+    Vector<PODVector<unsigned char>> journalRecords;
+    Undo::Journal::Read(context_, GetJournalPath(), journalResource, journalRecords);
+
     LoadResource(tab.GetAttribute("path"));
+    if (!journal_.IsOpen())
+        journal_.Open(GetJournalPath(), path_);
+
+    if (!journalRecords.Empty() && journalResource == path_)
+    {
+        undo_.Recover(journalRecords);
+        if (rootElement_->GetNumChildren() > 0)
+            PrepareLayout(rootElement_->GetChild(0));
+        URHO3D_LOGINFOF("Recovered %u unsaved changes of UI layout %s.", journalRecords.Size(),
+            GetTitle().CString());
+    }
 }
 
 String UITab::GetAppliedStyle(UIElement* element)
@@ -698,6 +758,8 @@ void UITab::AttributeMenu(VariantMap& args)
                         undo_.XMLSetVariantValue(styleAttribute, styleAttribute.GetVariantValue(info->type_));
                         undo_.XMLSetVariantValue(styleAttribute, value);
                     }
+                    // Attribute is no longer customized as modified style value.
+                    inspector_.InvalidateCustomization();
                 }
             }
         }
@@ -708,6 +770,7 @@ void UITab::AttributeMenu(VariantMap& args)
             {
                 styleAttribute.Remove();
                 // undo_.XMLRemove(styleAttribute);
+                inspector_.InvalidateCustomization();
             }
         }
 
@@ -25,6 +25,7 @@
 
 #include <Urho3D/Urho3DAll.h>
 #include <Toolbox/Common/UndoManager.h>
+#include <Toolbox/Common/UndoJournal.h>
 #include "Editor/Tabs/Tab.h"
 #include "Tabs/UI/RootUIElement.h"
 
@@ -68,6 +69,8 @@ protected:
     void SelectItem(UIElement* current);
     /// Searches resource path for style file in UI directory. First style found is applied. There are no restrictions on style file name.
     void AutoLoadDefaultStyle();
+    /// Disable features of loaded layout root element that interfere with editing.
+    void PrepareLayout(UIElement* layout);
     /// Render element context menu.
     void RenderElementContextMenu();
     ///
@@ -92,6 +95,8 @@ protected:
 
     WeakPtr<UIElement> selectedElement_;
     Undo::Manager undo_;
+    /// On-disk log of changes used for recovering unsaved changes.
+    Undo::Journal journal_;
     String path_;
     bool hideResizeHandles_ = false;
     Vector<String> styleNames_;
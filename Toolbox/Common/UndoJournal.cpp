@@ -0,0 +1,294 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Resource/XMLFile.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/UI/UIElement.h>
+
+#include "Common/UndoJournal.h"
+
+namespace Urho3D
+{
+
+namespace Undo
+{
+
+/// Identifier of journal files.
+static const char* JOURNAL_FILE_ID = "UJNL";
+/// Version of journal file format.
+static const unsigned JOURNAL_VERSION = 1;
+/// Time in milliseconds writer thread sleeps when there is nothing to write.
+static const unsigned JOURNAL_WRITE_INTERVAL = 10;
+
+/// Return checksum of record data.
+static unsigned GetChecksum(const PODVector<unsigned char>& data)
+{
+    unsigned checksum = 0;
+    for (unsigned char c : data)
+        checksum = SDBMHash(checksum, c);
+    return checksum;
+}
+
+Journal::Journal(Context* context)
+    : Object(context)
+{
+}
+
+Journal::~Journal()
+{
+    Close();
+}
+
+bool Journal::Open(const String& fileName, const String& resourceName)
+{
+    Close();
+
+    file_ = new File(context_, fileName, FILE_WRITE);
+    if (!file_->IsOpen())
+    {
+        URHO3D_LOGERRORF("Opening undo journal %s failed.", fileName.CString());
+        file_.Reset();
+        return false;
+    }
+
+    file_->WriteFileID(JOURNAL_FILE_ID);
+    file_->WriteUInt(JOURNAL_VERSION);
+    file_->WriteString(resourceName);
+    file_->Flush();
+
+    return Run();
+}
+
+void Journal::Close()
+{
+    if (file_.Null())
+        return;
+
+    // Writer thread exits only after queue is drained.
+    Stop();
+
+    String fileName = file_->GetName();
+    file_->Close();
+    file_.Reset();
+    queue_.Clear();
+
+    GetSubsystem<FileSystem>()->Delete(fileName);
+}
+
+void Journal::Append(const PODVector<unsigned char>& record)
+{
+    if (file_.Null())
+        return;
+
+    MutexLock lock(mutex_);
+    queue_.Push(record);
+}
+
+void Journal::ThreadFunction()
+{
+    Vector<PODVector<unsigned char>> records;
+    bool running = true;
+    while (running)
+    {
+        running = shouldRun_;
+        {
+            MutexLock lock(mutex_);
+            records.Swap(queue_);
+        }
+
+        if (records.Empty())
+        {
+            if (running)
+                Time::Sleep(JOURNAL_WRITE_INTERVAL);
+            continue;
+        }
+
+        for (const auto& record : records)
+        {
+            file_->WriteUInt(record.Size());
+            file_->WriteUInt(GetChecksum(record));
+            file_->Write(record.Buffer(), record.Size());
+        }
+        file_->Flush();
+        records.Clear();
+    }
+}
+
+bool Journal::Read(Context* context, const String& fileName, String& resourceName,
+    Vector<PODVector<unsigned char>>& records)
+{
+    if (!context->GetSubsystem<FileSystem>()->FileExists(fileName))
+        return false;
+
+    File file(context, fileName, FILE_READ);
+    if (!file.IsOpen() || file.ReadFileID() != JOURNAL_FILE_ID || file.ReadUInt() != JOURNAL_VERSION)
+        return false;
+
+    resourceName = file.ReadString();
+    while (file.GetSize() - file.GetPosition() >= 2 * sizeof(unsigned))
+    {
+        unsigned size = file.ReadUInt();
+        unsigned checksum = file.ReadUInt();
+        if (file.GetSize() - file.GetPosition() < size)
+            break;
+
+        PODVector<unsigned char> record(size);
+        file.Read(record.Buffer(), size);
+        if (GetChecksum(record) != checksum)
+            break;
+
+        records.Push(record);
+    }
+    return true;
+}
+
+/// Return creation mode matching ID of a node or component.
+static CreateMode GetCreateMode(unsigned id)
+{
+    return id < FIRST_LOCAL_ID ? REPLICATED : LOCAL;
+}
+
+void ReplayStates(Scene* scene, Deserializer& source)
+{
+    while (!source.IsEof())
+    {
+        switch (source.ReadUByte())
+        {
+        case JOURNAL_ATTRIBUTE:
+        {
+            bool isNode = source.ReadBool();
+            unsigned id = source.ReadUInt();
+            String name = source.ReadString();
+            auto type = (VariantType)source.ReadUByte();
+            Variant value = source.ReadVariant(type);
+
+            Serializable* item = nullptr;
+            if (isNode)
+                item = scene->GetNode(id);
+            else
+                item = scene->GetComponent(id);
+
+            if (item != nullptr)
+            {
+                item->SetAttribute(name, value);
+                item->ApplyAttributes();
+            }
+            break;
+        }
+        case JOURNAL_NODEPARENT:
+        {
+            unsigned id = source.ReadUInt();
+            unsigned parentID = source.ReadUInt();
+            if (parentID == 0)
+            {
+                Node* node = scene->GetNode(id);
+                if (node != nullptr && node != scene)
+                    node->Remove();
+                break;
+            }
+
+            unsigned index = source.ReadUInt();
+            PODVector<unsigned char> snapshot(source.ReadVLE());
+            source.Read(snapshot.Buffer(), snapshot.Size());
+
+            Node* parent = scene->GetNode(parentID);
+            if (parent == nullptr)
+                break;
+
+            if (Node* node = scene->GetNode(id))
+                parent->AddChild(node, index);
+            else
+            {
+                // Node is added to the scene before loading, so that it's components and children keep their IDs.
+                SharedPtr<Node> child(new Node(scene->GetContext()));
+                child->SetID(id);
+                parent->AddChild(child, index);
+                MemoryBuffer buffer(snapshot);
+                child->Load(buffer);
+            }
+            break;
+        }
+        case JOURNAL_COMPONENTPARENT:
+        {
+            unsigned id = source.ReadUInt();
+            unsigned nodeID = source.ReadUInt();
+            if (nodeID == 0)
+            {
+                if (Component* component = scene->GetComponent(id))
+                    component->Remove();
+                break;
+            }
+
+            PODVector<unsigned char> snapshot(source.ReadVLE());
+            source.Read(snapshot.Buffer(), snapshot.Size());
+
+            Node* node = scene->GetNode(nodeID);
+            if (node == nullptr || scene->GetComponent(id) != nullptr)
+                break;
+
+            // Snapshot begins with component type and ID.
+            MemoryBuffer buffer(snapshot);
+            StringHash type = buffer.ReadStringHash();
+            buffer.ReadUInt();
+            if (Component* component = node->CreateComponent(type, GetCreateMode(id), id))
+            {
+                component->Load(buffer);
+                component->ApplyAttributes();
+            }
+            break;
+        }
+        default:
+            URHO3D_LOGERROR("Undo journal contains unknown state type.");
+            return;
+        }
+    }
+}
+
+void ReplayLayout(UIElement* root, Deserializer& source)
+{
+    XMLFile xml(root->GetContext());
+    if (!xml.Load(source))
+    {
+        URHO3D_LOGERROR("Undo journal contains invalid UI layout.");
+        return;
+    }
+
+    root->RemoveAllChildren();
+    UIElement* child = root->CreateChild(xml.GetRoot().GetAttribute("type"));
+    if (child->LoadXML(xml.GetRoot()))
+        child->SetStyleAuto();
+    else
+        child->Remove();
+}
+
+}
+
+}
@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Thread.h>
+
+
+namespace Urho3D
+{
+
+class Deserializer;
+class File;
+class Scene;
+class UIElement;
+
+namespace Undo
+{
+
+/// Type of journal record. It is the first byte of every record.
+enum JournalRecordType : unsigned char
+{
+    /// Scene changes stored as a list of states.
+    JOURNAL_STATES,
+    /// Complete UI layout.
+    JOURNAL_LAYOUT,
+};
+
+/// Type of state stored in JOURNAL_STATES record.
+enum JournalStateType : unsigned char
+{
+    /// Attribute of a node or component.
+    JOURNAL_ATTRIBUTE,
+    /// Node added to or removed from the scene.
+    JOURNAL_NODEPARENT,
+    /// Component added to or removed from the scene.
+    JOURNAL_COMPONENTPARENT,
+};
+
+/// Append-only on-disk log of committed undo steps. It allows recovering changes that were not saved when editor
+/// terminated abnormally. Records are written on a background thread, so committing changes never waits for disk.
+class Journal : public Object, public Thread
+{
+    URHO3D_OBJECT(Journal, Object);
+public:
+    /// Construct.
+    explicit Journal(Context* context);
+    /// Destruct. Journal file is removed.
+    ~Journal() override;
+    /// Start a new journal file for specified resource. Existing file is overwritten.
+    bool Open(const String& fileName, const String& resourceName);
+    /// Finish writing pending records and remove journal file.
+    void Close();
+    /// Queue record for writing.
+    void Append(const PODVector<unsigned char>& record);
+    /// Return true if journal file is open.
+    bool IsOpen() const { return file_.NotNull(); }
+    /// Read records of a journal file. Reading stops at first incomplete or damaged record, which is the case when
+    /// editor terminated while record was being written.
+    static bool Read(Context* context, const String& fileName, String& resourceName,
+        Vector<PODVector<unsigned char>>& records);
+
+protected:
+    /// Write queued records to the file.
+    void ThreadFunction() override;
+
+    /// Journal file.
+    SharedPtr<File> file_;
+    /// Records waiting to be written.
+    Vector<PODVector<unsigned char>> queue_;
+    /// Mutex guarding queue_.
+    Mutex mutex_;
+};
+
+/// Apply states of JOURNAL_STATES record to the scene.
+void ReplayStates(Scene* scene, Deserializer& source);
+/// Replace children of UI root element with layout stored in JOURNAL_LAYOUT record.
+void ReplayLayout(UIElement* root, Deserializer& source);
+
+}
+
+}
@@ -20,18 +20,23 @@
 // THE SOFTWARE.
 //
 
+#include <Urho3D/Container/Allocator.h>
 #include <Urho3D/Core/Context.h>
 #include <Urho3D/Core/CoreEvents.h>
 #include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
 #include <Urho3D/Scene/Component.h>
 #include <Urho3D/Scene/Node.h>
 #include <Urho3D/Scene/Scene.h>
 #include <Urho3D/Scene/SceneEvents.h>
+#include <Urho3D/Resource/XMLFile.h>
 #include <Urho3D/UI/UI.h>
 
 #include "Common/UndoManager.h"
 #include "SystemUI/AttributeInspector.h"
 #include "SystemUI/Gizmo.h"
+#include "SystemUI/SystemUI.h"
 #include "SystemUI/SystemUIEvents.h"
 
 namespace Urho3D
@@ -40,37 +45,300 @@ namespace Urho3D
 namespace Undo
 {
 
-AttributeState::AttributeState(Serializable* item, const String& name, const Variant& value)
-    : item_(item)
+/// Size granularity of pooled state allocations.
+static const unsigned STATE_SIZE_GRANULARITY = 16;
+/// Number of state size classes served from pools. Larger states are allocated from the heap.
+static const unsigned STATE_SIZE_CLASSES = 16;
+/// Number of states preallocated when pool of a size class is created.
+static const unsigned STATE_POOL_CAPACITY = 256;
+/// Pools of state memory, one for every size class.
+static AllocatorBlock* statePools[STATE_SIZE_CLASSES] = {};
+
+/// Size of ValuePool chunks. Values larger than this get a chunk of their own.
+static const unsigned VALUE_CHUNK_SIZE = 4096;
+
+/// Return true if value of this type survives a round-trip through Serializer::WriteVariantData().
+static bool IsEncodable(VariantType type)
+{
+    switch (type)
+    {
+    case VAR_INT:
+    case VAR_BOOL:
+    case VAR_FLOAT:
+    case VAR_VECTOR2:
+    case VAR_VECTOR3:
+    case VAR_VECTOR4:
+    case VAR_QUATERNION:
+    case VAR_COLOR:
+    case VAR_STRING:
+    case VAR_BUFFER:
+    case VAR_RESOURCEREF:
+    case VAR_RESOURCEREFLIST:
+    case VAR_VARIANTVECTOR:
+    case VAR_VARIANTMAP:
+    case VAR_INTRECT:
+    case VAR_INTVECTOR2:
+    case VAR_MATRIX3:
+    case VAR_MATRIX3X4:
+    case VAR_MATRIX4:
+    case VAR_DOUBLE:
+    case VAR_STRINGVECTOR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Combine hash of a pointer into result.
+static void HashCombine(unsigned& result, const void* pointer)
+{
+    result ^= (unsigned)((size_t)pointer >> 3) + 0x9e3779b9 + (result << 6) + (result >> 2);
+}
+
+/// Combine hash value into result.
+static void HashCombine(unsigned& result, unsigned value)
+{
+    result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2);
+}
+
+/// Encode data as a list of (skip, length, bytes) runs that turn base into data. Both buffers must be of equal size.
+static void EncodePatch(const unsigned char* base, const unsigned char* data, unsigned size, VectorBuffer& patch)
+{
+    unsigned i = 0;
+    while (i < size)
+    {
+        unsigned start = i;
+        while (i < size && base[i] == data[i])
+            ++i;
+        patch.WriteVLE(i - start);
+
+        // Short runs of equal bytes are cheaper to include into modified run than to encode separately.
+        start = i;
+        unsigned equal = 0;
+        while (i < size && equal < 4)
+        {
+            equal = base[i] == data[i] ? equal + 1 : 0;
+            ++i;
+        }
+        i -= equal;
+        patch.WriteVLE(i - start);
+        patch.Write(data + start, i - start);
+    }
+}
+
+/// Apply patch produced by EncodePatch() to data.
+static void DecodePatch(const unsigned char* patch, unsigned patchSize, PODVector<unsigned char>& data)
+{
+    MemoryBuffer buffer(patch, patchSize);
+    unsigned position = 0;
+    while (!buffer.IsEof())
+    {
+        position += buffer.ReadVLE();
+        unsigned length = buffer.ReadVLE();
+        buffer.Read(data.Buffer() + position, length);
+        position += length;
+    }
+}
+
+void* State::operator new(size_t size)
+{
+    auto sizeClass = (unsigned)((size + STATE_SIZE_GRANULARITY - 1) / STATE_SIZE_GRANULARITY);
+    if (sizeClass >= STATE_SIZE_CLASSES)
+        return ::operator new(size);
+
+    AllocatorBlock*& pool = statePools[sizeClass];
+    if (pool == nullptr)
+        pool = AllocatorInitialize(sizeClass * STATE_SIZE_GRANULARITY, STATE_POOL_CAPACITY);
+    return AllocatorReserve(pool);
+}
+
+void State::operator delete(void* p, size_t size)
+{
+    auto sizeClass = (unsigned)((size + STATE_SIZE_GRANULARITY - 1) / STATE_SIZE_GRANULARITY);
+    if (sizeClass >= STATE_SIZE_CLASSES)
+        ::operator delete(p);
+    else
+        AllocatorFree(statePools[sizeClass], p);
+}
+
+EncodedValue ValuePool::Store(const void* data, unsigned size)
+{
+    EncodedValue result;
+    if (size > VALUE_CHUNK_SIZE)
+        result.chunk_ = new ValueChunk();
+    else
+    {
+        if (current_.Null() || current_->data_.Size() + size > VALUE_CHUNK_SIZE)
+        {
+            current_ = new ValueChunk();
+            current_->data_.Reserve(VALUE_CHUNK_SIZE);
+        }
+        result.chunk_ = current_;
+    }
+
+    result.offset_ = result.chunk_->data_.Size();
+    result.size_ = size;
+    result.chunk_->data_.Resize(result.offset_ + size);
+    memcpy(result.chunk_->data_.Buffer() + result.offset_, data, size);
+    return result;
+}
+
+AttributeState::AttributeState(ValuePool* pool, Serializable* item, const String& name, const Variant& value,
+    AttributeState* base)
+    : State(TYPE)
+    , item_(item)
     , name_(name)
-    , value_(value)
+    , pool_(pool)
+    , type_(value.GetType())
+{
+    if (!IsEncodable(type_))
+    {
+        value_ = value;
+        return;
+    }
+
+    VectorBuffer buffer;
+    buffer.WriteVariantData(value);
+
+    if (base != nullptr && base->type_ == type_ && base->value_.IsEmpty())
+    {
+        PODVector<unsigned char> baseData;
+        base->GetEncodedValue(baseData);
+        if (baseData.Size() == buffer.GetSize())
+        {
+            VectorBuffer patch;
+            EncodePatch(baseData.Buffer(), buffer.GetData(), buffer.GetSize(), patch);
+            if (patch.GetSize() < buffer.GetSize())
+            {
+                encoded_ = pool_->Store(patch.GetData(), patch.GetSize());
+                base_ = base;
+                return;
+            }
+        }
+    }
+
+    encoded_ = pool_->Store(buffer.GetData(), buffer.GetSize());
+}
+
+void AttributeState::GetEncodedValue(PODVector<unsigned char>& data) const
+{
+    if (base_.Null())
+    {
+        data.Resize(encoded_.size_);
+        memcpy(data.Buffer(), encoded_.GetData(), encoded_.size_);
+    }
+    else
+    {
+        base_->GetEncodedValue(data);
+        DecodePatch(encoded_.GetData(), encoded_.size_, data);
+    }
+}
+
+Variant AttributeState::GetValue() const
 {
+    if (!IsEncodable(type_))
+        return value_;
+
+    PODVector<unsigned char> data;
+    GetEncodedValue(data);
+    MemoryBuffer buffer(data);
+    return buffer.ReadVariant(type_);
 }
 
 void AttributeState::Apply()
 {
-    item_->SetAttribute(name_, value_);
+    item_->SetAttribute(name_, GetValue());
     item_->ApplyAttributes();
 }
 
 bool AttributeState::Equals(State* other) const
 {
-    auto other_ = dynamic_cast<AttributeState*>(other);
+    auto other_ = other->Cast<AttributeState>();
     if (!other_)
         return false;
 
-    if (item_ != other_->item_)
+    if (item_ != other_->item_ || type_ != other_->type_ || name_ != other_->name_)
         return false;
 
-    return value_ == other_->value_;
+    if (!IsEncodable(type_))
+        return value_ == other_->value_;
+
+    // Compare encoded values directly when neither of them is a patch.
+    if (base_.Null() && other_->base_.Null())
+    {
+        return encoded_.size_ == other_->encoded_.size_ &&
+            memcmp(encoded_.GetData(), other_->encoded_.GetData(), encoded_.size_) == 0;
+    }
+
+    PODVector<unsigned char> data, otherData;
+    GetEncodedValue(data);
+    other_->GetEncodedValue(otherData);
+    return data == otherData;
+}
+
+unsigned AttributeState::ToHash() const
+{
+    unsigned hash = name_.ToHash();
+    HashCombine(hash, item_.Get());
+    return hash;
 }
 
 String AttributeState::ToString() const
 {
-    return Urho3D::ToString("AttributeState %s = %s", name_.CString(), value_.ToString().CString());
+    return Urho3D::ToString("AttributeState %s = %s", name_.CString(), GetValue().ToString().CString());
+}
+
+bool AttributeState::Save(Serializer& dest) const
+{
+    if (!IsEncodable(type_))
+        return false;
+
+    bool isNode = false;
+    unsigned id = 0;
+    if (auto node = dynamic_cast<Node*>(item_.Get()))
+    {
+        isNode = true;
+        id = node->GetID();
+    }
+    else if (auto component = dynamic_cast<Component*>(item_.Get()))
+        id = component->GetID();
+
+    // Item is not a part of the scene.
+    if (id == 0)
+        return false;
+
+    PODVector<unsigned char> data;
+    GetEncodedValue(data);
+
+    dest.WriteUByte(JOURNAL_ATTRIBUTE);
+    dest.WriteBool(isNode);
+    dest.WriteUInt(id);
+    dest.WriteString(name_);
+    dest.WriteUByte((unsigned char)type_);
+    dest.Write(data.Buffer(), data.Size());
+    return true;
+}
+
+unsigned AttributeState::GetMemoryUse() const
+{
+    return sizeof(*this) + name_.Length() + encoded_.size_;
+}
+
+void AttributeState::Detach()
+{
+    if (base_.Null())
+        return;
+
+    PODVector<unsigned char> data;
+    GetEncodedValue(data);
+    encoded_ = pool_->Store(data.Buffer(), data.Size());
+    base_.Reset();
 }
 
-ElementParentState::ElementParentState(UIElement* item, UIElement* parent) : item_(item), parent_(parent)
+ElementParentState::ElementParentState(UIElement* item, UIElement* parent)
+    : State(TYPE)
+    , item_(item)
+    , parent_(parent)
 {
     if (parent)
         index_ = parent->FindChild(item);
@@ -86,7 +354,7 @@ void ElementParentState::Apply()
 
 bool ElementParentState::Equals(State* other) const
 {
-    auto other_ = dynamic_cast<ElementParentState*>(other);
+    auto other_ = other->Cast<ElementParentState>();
 
     if (other_ == nullptr)
         return false;
@@ -94,13 +362,25 @@ bool ElementParentState::Equals(State* other) const
     return item_ == other_->item_ && parent_ == other_->parent_ && index_ == other_->index_;
 }
 
+unsigned ElementParentState::ToHash() const
+{
+    unsigned hash = index_;
+    HashCombine(hash, item_.Get());
+    HashCombine(hash, parent_.Get());
+    return hash;
+}
+
 String ElementParentState::ToString() const
 {
     return Urho3D::ToString("ElementParentState parent = %p child = %p index = %d", parent_.Get(), item_.Get(), index_);
 }
 
-NodeParentState::NodeParentState(Node* item, Node* parent) : item_(item), parent_(parent)
+NodeParentState::NodeParentState(Node* item, Node* parent)
+    : State(TYPE)
+    , item_(item)
+    , parent_(parent)
 {
+    id_ = item->GetID();
     if (parent)
         index_ = parent->GetChildren().IndexOf(SharedPtr<Node>(item));
 }
@@ -115,7 +395,7 @@ void NodeParentState::Apply()
 
 bool NodeParentState::Equals(State* other) const
 {
-    auto other_ = dynamic_cast<NodeParentState*>(other);
+    auto other_ = other->Cast<NodeParentState>();
 
     if (other_ == nullptr)
         return false;
@@ -123,12 +403,56 @@ bool NodeParentState::Equals(State* other) const
     return item_ == other_->item_ && parent_ == other_->parent_ && index_ == other_->index_;
 }
 
+unsigned NodeParentState::ToHash() const
+{
+    unsigned hash = index_;
+    HashCombine(hash, item_.Get());
+    HashCombine(hash, parent_.Get());
+    return hash;
+}
+
+bool NodeParentState::Save(Serializer& dest) const
+{
+    if (parent_.Null())
+    {
+        // Node that is still a part of the scene is about to be removed by undo or redo. Otherwise node is already
+        // removed and ID saved at the time of removal is used.
+        unsigned id = item_->GetID() != 0 ? item_->GetID() : id_;
+        if (id == 0)
+            return false;
+
+        dest.WriteUByte(JOURNAL_NODEPARENT);
+        dest.WriteUInt(id);
+        dest.WriteUInt(0);
+        return true;
+    }
+
+    // Node may have been removed again after it was added.
+    if (item_->GetParent() != parent_ || parent_->GetScene() == nullptr)
+        return false;
+
+    VectorBuffer snapshot;
+    if (!item_->Save(snapshot))
+        return false;
+
+    dest.WriteUByte(JOURNAL_NODEPARENT);
+    dest.WriteUInt(item_->GetID());
+    dest.WriteUInt(parent_->GetID());
+    dest.WriteUInt(index_);
+    dest.WriteVLE(snapshot.GetSize());
+    dest.Write(snapshot.GetData(), snapshot.GetSize());
+    return true;
+}
+
 String NodeParentState::ToString() const
 {
     return Urho3D::ToString("NodeParentState parent = %p child = %p index = %d", parent_.Get(), item_.Get(), index_);
 }
 
-ComponentParentState::ComponentParentState(Component* item, Node* parent) : item_(item), parent_(parent)
+ComponentParentState::ComponentParentState(Component* item, Node* parent)
+    : State(TYPE)
+    , item_(item)
+    , parent_(parent)
 {
     id_ = item->GetID();
 }
@@ -149,7 +473,7 @@ void ComponentParentState::Apply()
 
 bool ComponentParentState::Equals(State* other) const
 {
-    auto other_ = dynamic_cast<ComponentParentState*>(other);
+    auto other_ = other->Cast<ComponentParentState>();
 
     if (other_ == nullptr)
         return false;
@@ -157,12 +481,53 @@ bool ComponentParentState::Equals(State* other) const
     return item_ == other_->item_ && parent_ == other_->parent_ && id_ == other_->id_;
 }
 
+unsigned ComponentParentState::ToHash() const
+{
+    unsigned hash = id_;
+    HashCombine(hash, item_.Get());
+    HashCombine(hash, parent_.Get());
+    return hash;
+}
+
+bool ComponentParentState::Save(Serializer& dest) const
+{
+    if (parent_.Null())
+    {
+        // Same as with nodes, component ID is reset when it is removed from the scene.
+        unsigned id = item_->GetID() != 0 ? item_->GetID() : id_;
+        if (id == 0)
+            return false;
+
+        dest.WriteUByte(JOURNAL_COMPONENTPARENT);
+        dest.WriteUInt(id);
+        dest.WriteUInt(0);
+        return true;
+    }
+
+    if (item_->GetNode() != parent_ || parent_->GetScene() == nullptr)
+        return false;
+
+    VectorBuffer snapshot;
+    if (!item_->Save(snapshot))
+        return false;
+
+    dest.WriteUByte(JOURNAL_COMPONENTPARENT);
+    dest.WriteUInt(item_->GetID());
+    dest.WriteUInt(parent_->GetID());
+    dest.WriteVLE(snapshot.GetSize());
+    dest.Write(snapshot.GetData(), snapshot.GetSize());
+    return true;
+}
+
 String ComponentParentState::ToString() const
 {
     return Urho3D::ToString("ComponentParentState parent = %p child = %p id = %d", parent_.Get(), item_.Get(), id_);
 }
 
-XMLVariantState::XMLVariantState(const XMLElement& item, const Variant& value) : item_(item), value_(value)
+XMLVariantState::XMLVariantState(const XMLElement& item, const Variant& value)
+    : State(TYPE)
+    , item_(item)
+    , value_(value)
 {
 }
 
@@ -173,7 +538,7 @@ void XMLVariantState::Apply()
 
 bool XMLVariantState::Equals(State* other) const
 {
-    auto other_ = dynamic_cast<XMLVariantState*>(other);
+    auto other_ = other->Cast<XMLVariantState>();
 
     if (other_ == nullptr)
         return false;
@@ -181,12 +546,20 @@ bool XMLVariantState::Equals(State* other) const
     return (item_.GetName() == other_->item_.GetName()) && (value_ == other_->value_);
 }
 
+unsigned XMLVariantState::ToHash() const
+{
+    return item_.GetName().ToHash();
+}
+
 String XMLVariantState::ToString() const
 {
     return Urho3D::ToString("XMLVariantState value = %s", value_.ToString().CString());
 }
 
-XMLParentState::XMLParentState(const XMLElement& item, const XMLElement& parent) : item_(item), parent_(parent)
+XMLParentState::XMLParentState(const XMLElement& item, const XMLElement& parent)
+    : State(TYPE)
+    , item_(item)
+    , parent_(parent)
 {
 }
 
@@ -200,7 +573,7 @@ void XMLParentState::Apply()
 
 bool XMLParentState::Equals(State* other) const
 {
-    auto other_ = dynamic_cast<XMLParentState*>(other);
+    auto other_ = other->Cast<XMLParentState>();
 
     if (other_ == nullptr)
         return false;
@@ -208,6 +581,14 @@ bool XMLParentState::Equals(State* other) const
     return item_.GetNode() == other_->item_.GetNode() && parent_.GetNode() == other_->parent_.GetNode();
 }
 
+unsigned XMLParentState::ToHash() const
+{
+    unsigned hash = 0;
+    HashCombine(hash, item_.GetNode());
+    HashCombine(hash, parent_.GetNode());
+    return hash;
+}
+
 String XMLParentState::ToString() const
 {
     return Urho3D::ToString("XMLParentState parent = %s", parent_.IsNull() ? "null" : "set");
@@ -221,6 +602,10 @@ void StateCollection::Apply()
 
 bool StateCollection::Contains(State* other) const
 {
+    if (lookup_.Size() == states_.Size())
+        return lookup_.Contains(StateKey(other));
+
+    // Lookup table was released.
     for (const auto& state : states_)
     {
         if (state->Equals(other))
@@ -231,52 +616,174 @@ bool StateCollection::Contains(State* other) const
 
 bool StateCollection::PushUnique(const SharedPtr<State>& state)
 {
-    if (!Contains(state))
+    if (lookup_.Size() != states_.Size())
+    {
+        lookup_.Clear();
+        for (const auto& existing : states_)
+            lookup_.Insert(StateKey(existing));
+    }
+
+    if (!lookup_.Contains(StateKey(state)))
     {
         states_.Push(state);
+        lookup_.Insert(StateKey(state));
+        memoryUse_ += state->GetMemoryUse();
         return true;
     }
     return false;
 }
 
+void StateCollection::Detach()
+{
+    memoryUse_ = 0;
+    for (auto& state : states_)
+    {
+        state->Detach();
+        memoryUse_ += state->GetMemoryUse();
+    }
+}
+
 Manager::Manager(Context* ctx) : Object(ctx)
 {
     SubscribeToEvent(E_ENDFRAME, [&](StringHash, VariantMap&)
     {
-        if (!trackingSuspended_)
-        {
-            assert(previous_.Size() == next_.Size());
+        if (!trackingSuspended_ && groupDepth_ == 0)
+            Commit();
+        // Merged changes are journaled once merging ends.
+        if (journalPending_ && !IsCoalesceWindowOpen())
+            FlushJournal();
+    });
+}
 
-            if (previous_.Size())
-            {
-                // When stack is empty we insert two items - old state and new state. When stack already has states
-                // saved - we save old state to the state collection at the end of the stack and insert new
-                // collection for a new state.
-                if (stack_.Empty())
-                {
-                    stack_.Resize(1);
-                    index_++;
-                }
-
-                for (auto& state : previous_)
-                {
-                    if (stack_.Back().PushUnique(state))
-                        URHO3D_LOGDEBUGF("UNDO: Save %d: %s", index_, state->ToString().CString());
-                }
-
-                index_++;
-                stack_.Resize(index_ + 1);
-
-                for (auto& state : next_)
-                {
-                    if (stack_.Back().PushUnique(state))
-                        URHO3D_LOGDEBUGF("UNDO: Save %d: %s", index_, state->ToString().CString());
-                }
-                previous_.Clear();
-                next_.Clear();
-            }
+void Manager::Commit(bool allowCoalesce)
+{
+    assert(previous_.Size() == next_.Size());
+
+    removedNodes_.Clear();
+    if (previous_.Empty())
+        return;
+
+    if (allowCoalesce && TryCoalesce())
+        return;
+
+    // Changes merged into previous step are journaled before the new step.
+    FlushJournal();
+
+    // When stack is empty we insert two items - old state and new state. When stack already has states saved - we
+    // save old state to the current state collection and insert new collection for a new state. Redo history is
+    // discarded.
+    if (stack_.Empty())
+    {
+        stack_.Resize(1);
+        index_++;
+    }
+    stack_.Resize(index_ + 1);
+
+    unsigned saved = 0;
+    for (auto& state : previous_)
+        saved += stack_.Back().PushUnique(state) ? 1 : 0;
+    // Nothing will be appended to this collection anymore.
+    stack_.Back().ReleaseLookup();
+    URHO3D_LOGDEBUGF("UNDO: Save %d: %u states", index_, saved);
+
+    index_++;
+    stack_.Resize(index_ + 1);
+
+    saved = 0;
+    for (auto& state : next_)
+        saved += stack_.Back().PushUnique(state) ? 1 : 0;
+    URHO3D_LOGDEBUGF("UNDO: Save %d: %u states", index_, saved);
+
+    // Only steps consisting of attribute changes may absorb further changes.
+    lastCommitCoalescible_ = allowCoalesce;
+    for (auto& state : next_)
+        lastCommitCoalescible_ = lastCommitCoalescible_ && state->GetStateType() == STATE_ATTRIBUTE;
+    coalesceTimer_.Reset();
+
+    WriteJournal(next_);
+    previous_.Clear();
+    next_.Clear();
+
+    EnforceBudget();
+}
+
+bool Manager::TryCoalesce()
+{
+    // Last step must be on top of the stack, undo or redo in between breaks the sequence.
+    if (!lastCommitCoalescible_ || index_ < 1 || index_ != stack_.Size() - 1)
+        return false;
+
+    if (!IsCoalesceWindowOpen())
+        return false;
+
+    // Changes must modify exactly the same attributes of the same items.
+    const auto& last = stack_.Back().states_;
+    if (last.Size() != next_.Size())
+        return false;
+    for (unsigned i = 0; i < next_.Size(); i++)
+    {
+        auto* lastState = last[i]->Cast<AttributeState>();
+        auto* nextState = next_[i]->Cast<AttributeState>();
+        if (lastState == nullptr || nextState == nullptr || lastState->item_ != nextState->item_ ||
+            lastState->name_ != nextState->name_)
+            return false;
+    }
+
+    // Oldest "before" states are already saved in previous collection. Newest "after" states replace ones of last
+    // step. They may be patches against "before" states being discarded, therefore they are detached.
+    StateCollection collection;
+    for (auto& state : next_)
+    {
+        state->Detach();
+        collection.PushUnique(state);
+    }
+    stack_.Back() = collection;
+    URHO3D_LOGDEBUGF("UNDO: Merge %d: %u states", index_, next_.Size());
+
+    coalesceTimer_.Reset();
+
+    // Serializing states, or whole UI layout, every frame would stall continuous edits. Only the final result of
+    // merged changes is journaled.
+    journalPending_ = true;
+    previous_.Clear();
+    next_.Clear();
+
+    EnforceBudget();
+    return true;
+}
+
+bool Manager::IsCoalesceWindowOpen()
+{
+    bool withinInterval = coalesceInterval_ > 0 && coalesceTimer_.GetMSec(false) < coalesceInterval_;
+    bool widgetActive = coalesceWhileActive_ && ui::GetCurrentContext() != nullptr && ui::IsAnyItemActive();
+    return withinInterval || widgetActive;
+}
+
+void Manager::FlushJournal()
+{
+    if (!journalPending_)
+        return;
+
+    journalPending_ = false;
+    if (!stack_.Empty())
+        WriteJournal(stack_.Back().states_);
+}
+
+void Manager::WriteJournal(const Vector<SharedPtr<State>>& states)
+{
+    if (journal_.NotNull())
+    {
+        VectorBuffer record;
+        if (scene_.NotNull())
+        {
+            record.WriteUByte(JOURNAL_STATES);
+            for (auto& state : states)
+                state->Save(record);
+            journal_->Append(record.GetBuffer());
         }
-    });
+        else if (SaveLayout(record))
+            journal_->Append(record.GetBuffer());
+    }
 }
 
 void Manager::Undo()
@@ -293,18 +800,170 @@ void Manager::Clear()
 {
     previous_.Clear();
     next_.Clear();
+    removedNodes_.Clear();
     stack_.Clear();
+    pool_.Clear();
     index_ = -1;
+    lastCommitCoalescible_ = false;
+    journalPending_ = false;
+}
+
+bool Manager::IsInRemovedSubtree(Node* node) const
+{
+    if (node == nullptr || removedNodes_.Empty())
+        return false;
+
+    // Subtree root was detached from the scene, therefore it is the topmost node.
+    while (node->GetParent() != nullptr)
+        node = node->GetParent();
+    return removedNodes_.Contains(node);
+}
+
+bool Manager::SaveLayout(Serializer& dest) const
+{
+    if (root_.Null() || root_->GetNumChildren() == 0)
+        return false;
+
+    XMLFile xml(context_);
+    XMLElement layout = xml.CreateRoot("element");
+    if (!root_->GetChild(0)->SaveXML(layout))
+        return false;
+
+    dest.WriteUByte(JOURNAL_LAYOUT);
+    return xml.Save(dest);
+}
+
+void Manager::Recover(const Vector<PODVector<unsigned char>>& records)
+{
+    trackingSuspended_ = true;
+
+    // Only latest layout matters.
+    const PODVector<unsigned char>* layout = nullptr;
+    for (const auto& record : records)
+    {
+        MemoryBuffer buffer(record);
+        auto type = (JournalRecordType)buffer.ReadUByte();
+        if (type == JOURNAL_STATES && scene_.NotNull())
+            ReplayStates(scene_, buffer);
+        else if (type == JOURNAL_LAYOUT)
+            layout = &record;
+
+        if (journal_.NotNull())
+            journal_->Append(record);
+    }
+
+    if (layout != nullptr && root_.NotNull())
+    {
+        MemoryBuffer buffer(*layout);
+        buffer.ReadUByte();
+        ReplayLayout(root_, buffer);
+    }
+
+    trackingSuspended_ = false;
+}
+
+void Manager::BeginGroup()
+{
+    // Changes tracked before the group do not belong to it.
+    if (groupDepth_ == 0 && !trackingSuspended_)
+        Commit();
+    groupDepth_++;
+}
+
+void Manager::EndGroup()
+{
+    assert(groupDepth_ > 0);
+    // Group is a deliberate undo step, it is never merged with other changes.
+    if (--groupDepth_ == 0 && !trackingSuspended_)
+        Commit(false);
+}
+
+void Manager::SetMemoryBudget(unsigned bytes)
+{
+    memoryBudget_ = bytes;
+    EnforceBudget();
+}
+
+void Manager::SetMaxEntries(unsigned count)
+{
+    maxEntries_ = count;
+    EnforceBudget();
+}
+
+unsigned Manager::GetMemoryUse() const
+{
+    unsigned memoryUse = 0;
+    for (const auto& collection : stack_)
+        memoryUse += collection.memoryUse_;
+    return memoryUse;
+}
+
+void Manager::EnforceBudget()
+{
+    if (memoryBudget_ == 0 && maxEntries_ == 0)
+        return;
+
+    unsigned memoryUse = GetMemoryUse();
+    unsigned numEntries = GetNumEntries();
+    int32_t count = 0;
+    // Collection at index_ is current state and is never discarded.
+    while (count < index_)
+    {
+        bool overMemory = memoryBudget_ > 0 && memoryUse > memoryBudget_;
+        bool overEntries = maxEntries_ > 0 && numEntries > maxEntries_;
+        if (!overMemory && !overEntries)
+            break;
+
+        memoryUse -= stack_[count].memoryUse_;
+        numEntries--;
+        count++;
+    }
+
+    if (count == 0)
+        return;
+
+    stack_.Erase(0, (unsigned)count);
+    index_ -= count;
+    // States of new oldest collection may be encoded as patches against states that were just discarded.
+    stack_.Front().Detach();
+    URHO3D_LOGDEBUGF("UNDO: Discarded %d oldest entries, history uses %u bytes", count, GetMemoryUse());
 }
 
 void Manager::ApplyStateFromStack(bool forward)
 {
+    // Merged changes precede undo or redo in the journal.
+    FlushJournal();
     trackingSuspended_ = true;
+    lastCommitCoalescible_ = false;
     int direction = forward ? 1 : -1;
     index_ += direction;
     if (index_ >= 0 && index_ < stack_.Size())
     {
-        stack_[index_].Apply();
+        if (journal_.NotNull() && scene_.NotNull())
+        {
+            VectorBuffer record;
+            record.WriteUByte(JOURNAL_STATES);
+            for (auto& state : stack_[index_].states_)
+            {
+                // Items are journaled by their IDs. Removed items must be saved while they still have an ID, added
+                // items only get an ID when they are added.
+                bool isRemoval = state->IsRemoval();
+                if (isRemoval)
+                    state->Save(record);
+                state->Apply();
+                if (!isRemoval)
+                    state->Save(record);
+            }
+            journal_->Append(record.GetBuffer());
+        }
+        else
+        {
+            stack_[index_].Apply();
+
+            VectorBuffer record;
+            if (journal_.NotNull() && SaveLayout(record))
+                journal_->Append(record.GetBuffer());
+        }
         URHO3D_LOGDEBUGF("Undo: apply %d", index_);
     }
     index_ = Clamp<int32_t>(index_, 0, stack_.Size() - 1);
@@ -314,8 +973,15 @@ void Manager::ApplyStateFromStack(bool forward)
 void Manager::TrackState(Serializable* item, const String& name, const Variant& value, const Variant& oldValue)
 {
     // Item has it's state already modified, manually track the change.
-    TrackBefore<AttributeState>(item, name, oldValue);
-    TrackAfter<AttributeState>(item, name, value);
+    TrackAttribute(item, name, oldValue, value);
+}
+
+void Manager::TrackAttribute(Serializable* item, const String& name, const Variant& oldValue,
+    const Variant& newValue)
+{
+    // New value is usually a small modification of old value, therefore it is stored as a patch.
+    auto* before = TrackBefore<AttributeState>(&pool_, item, name, oldValue);
+    TrackAfter<AttributeState>(&pool_, item, name, newValue, before);
 }
 
 XMLElement Manager::XMLCreate(XMLElement& parent, const String& name)
@@ -341,25 +1007,31 @@ void Manager::XMLSetVariantValue(XMLElement& element, const Variant& value)
 }
 
 template<typename T, typename... Args>
-void Manager::TrackBefore(Args... args)
+T* Manager::TrackBefore(Args... args)
 {
-    previous_.Push(SharedPtr<State>(new T(args...)));
+    auto* state = new T(args...);
+    previous_.Push(SharedPtr<State>(state));
+    return state;
 }
 
 template<typename T, typename... Args>
-void Manager::TrackAfter(Args... args)
+T* Manager::TrackAfter(Args... args)
 {
-    next_.Push(SharedPtr<State>(new T(args...)));
+    auto* state = new T(args...);
+    next_.Push(SharedPtr<State>(state));
+    return state;
 }
 void Manager::Connect(Scene* scene)
 {
+    scene_ = scene;
+
     SubscribeToEvent(scene, E_NODEADDED, [&](StringHash, VariantMap& args) {
         if (trackingSuspended_)
             return;
 
         using namespace NodeRemoved;
-        auto node = dynamic_cast<Node*>(args[P_NODE].GetPtr());
-        auto parent = dynamic_cast<Node*>(args[P_PARENT].GetPtr());
+        auto node = static_cast<Node*>(args[P_NODE].GetPtr());
+        auto parent = static_cast<Node*>(args[P_PARENT].GetPtr());
 
         TrackBefore<NodeParentState>(node, nullptr);        // Removed from the scene state
         TrackAfter<NodeParentState>(node, parent);          // Present in the scene state
@@ -370,11 +1042,16 @@ void Manager::Connect(Scene* scene)
             return;
 
         using namespace NodeRemoved;
-        auto node = dynamic_cast<Node*>(args[P_NODE].GetPtr());
-        auto parent = dynamic_cast<Node*>(args[P_PARENT].GetPtr());
+        auto node = static_cast<Node*>(args[P_NODE].GetPtr());
+        auto parent = static_cast<Node*>(args[P_PARENT].GetPtr());
+
+        // Restoring removed subtree root restores this node as well.
+        if (IsInRemovedSubtree(parent))
+            return;
 
         TrackBefore<NodeParentState>(node, parent);        // Present in the scene state
         TrackAfter<NodeParentState>(node, nullptr);        // Removed from the scene state
+        removedNodes_.Insert(node);
     });
 
     SubscribeToEvent(scene, E_COMPONENTADDED, [&](StringHash, VariantMap& args) {
@@ -382,8 +1059,8 @@ void Manager::Connect(Scene* scene)
             return;
 
         using namespace ComponentAdded;
-        auto component = dynamic_cast<Component*>(args[P_COMPONENT].GetPtr());
-        auto parent = dynamic_cast<Node*>(args[P_NODE].GetPtr());
+        auto component = static_cast<Component*>(args[P_COMPONENT].GetPtr());
+        auto parent = static_cast<Node*>(args[P_NODE].GetPtr());
 
         TrackBefore<ComponentParentState>(component, nullptr);
         TrackAfter<ComponentParentState>(component, parent);
@@ -394,8 +1071,12 @@ void Manager::Connect(Scene* scene)
             return;
 
         using namespace ComponentAdded;
-        auto component = dynamic_cast<Component*>(args[P_COMPONENT].GetPtr());
-        auto parent = dynamic_cast<Node*>(args[P_NODE].GetPtr());
+        auto component = static_cast<Component*>(args[P_COMPONENT].GetPtr());
+        auto parent = static_cast<Node*>(args[P_NODE].GetPtr());
+
+        // Restoring removed subtree root restores this component as well.
+        if (IsInRemovedSubtree(parent))
+            return;
 
         TrackBefore<ComponentParentState>(component, parent);
         TrackAfter<ComponentParentState>(component, nullptr);
@@ -409,24 +1090,28 @@ void Manager::Connect(AttributeInspector* inspector)
             return;
 
         using namespace AttributeInspectorValueModified;
-        auto item = dynamic_cast<Serializable*>(args[P_SERIALIZABLE].GetPtr());
+        auto item = static_cast<Serializable*>(args[P_SERIALIZABLE].GetPtr());
 
         auto attributeName = reinterpret_cast<AttributeInfo*>(args[P_ATTRIBUTEINFO].GetVoidPtr())->name_;
-        TrackBefore<AttributeState>(item, attributeName, args[P_OLDVALUE]);
-        TrackAfter<AttributeState>(item, attributeName, args[P_NEWVALUE]);
+        TrackAttribute(item, attributeName, args[P_OLDVALUE], args[P_NEWVALUE]);
     });
+    // Modification of multiple items is undone in one step.
+    SubscribeToEvent(inspector, E_ATTRIBUTEINSPECTBATCHBEGIN, [&](StringHash, VariantMap&) { BeginGroup(); });
+    SubscribeToEvent(inspector, E_ATTRIBUTEINSPECTBATCHEND, [&](StringHash, VariantMap&) { EndGroup(); });
 }
 
 void Manager::Connect(UIElement* root)
 {
+    root_ = root;
+
     SubscribeToEvent(E_ELEMENTADDED, [&, root](StringHash, VariantMap& args) {
         if (trackingSuspended_)
             return;
 
         using namespace ElementAdded;
-        auto element = dynamic_cast<UIElement*>(args[P_ELEMENT].GetPtr());
-        auto parent = dynamic_cast<UIElement*>(args[P_PARENT].GetPtr());
-        auto eventRoot = dynamic_cast<UIElement*>(args[P_ROOT].GetPtr());
+        auto element = static_cast<UIElement*>(args[P_ELEMENT].GetPtr());
+        auto parent = static_cast<UIElement*>(args[P_PARENT].GetPtr());
+        auto eventRoot = static_cast<UIElement*>(args[P_ROOT].GetPtr());
 
         if (root != eventRoot)
             return;
@@ -440,9 +1125,9 @@ void Manager::Connect(UIElement* root)
             return;
 
         using namespace ElementRemoved;
-        auto element = dynamic_cast<UIElement*>(args[P_ELEMENT].GetPtr());
-        auto parent = dynamic_cast<UIElement*>(args[P_PARENT].GetPtr());
-        auto eventRoot = dynamic_cast<UIElement*>(args[P_ROOT].GetPtr());
+        auto element = static_cast<UIElement*>(args[P_ELEMENT].GetPtr());
+        auto parent = static_cast<UIElement*>(args[P_PARENT].GetPtr());
+        auto eventRoot = static_cast<UIElement*>(args[P_ROOT].GetPtr());
 
         if (root != eventRoot)
             return;
@@ -456,17 +1141,13 @@ void Manager::Connect(Gizmo* gizmo)
 {
     SubscribeToEvent(gizmo, E_GIZMONODEMODIFIED, [&](StringHash, VariantMap& args) {
         using namespace GizmoNodeModified;
-        auto node = dynamic_cast<Node*>(args[P_NODE].GetPtr());
+        auto node = static_cast<Node*>(args[P_NODE].GetPtr());
         auto oldTransform = args[P_OLDTRANSFORM].GetMatrix3x4();
         auto newTransform = args[P_NEWTRANSFORM].GetMatrix3x4();
 
-        TrackBefore<AttributeState>(node, "Position", oldTransform.Translation());
-        TrackBefore<AttributeState>(node, "Rotation", oldTransform.Rotation());
-        TrackBefore<AttributeState>(node, "Scale", oldTransform.Scale());
-
-        TrackAfter<AttributeState>(node, "Position", newTransform.Translation());
-        TrackAfter<AttributeState>(node, "Rotation", newTransform.Rotation());
-        TrackAfter<AttributeState>(node, "Scale", newTransform.Scale());
+        TrackAttribute(node, "Position", oldTransform.Translation(), newTransform.Translation());
+        TrackAttribute(node, "Rotation", oldTransform.Rotation(), newTransform.Rotation());
+        TrackAttribute(node, "Scale", oldTransform.Scale(), newTransform.Scale());
     });
 }
 
@@ -23,7 +23,10 @@
 #pragma once
 
 
+#include <Urho3D/Container/HashSet.h>
 #include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include "Common/UndoJournal.h"
 
 
 namespace Urho3D
@@ -32,55 +35,168 @@ namespace Urho3D
 class AttributeInspector;
 class Gizmo;
 class Scene;
+class Serializer;
 
 namespace Undo
 {
 
-/// Abstract class for implementing various trackable states.
+/// Block of memory shared by encoded values of multiple states.
+class ValueChunk : public RefCounted
+{
+public:
+    /// Encoded values.
+    PODVector<unsigned char> data_;
+};
+
+/// Reference to encoded value stored in a ValuePool.
+struct EncodedValue
+{
+    /// Return pointer to encoded data.
+    const unsigned char* GetData() const { return chunk_->data_.Buffer() + offset_; }
+
+    /// Chunk holding encoded data.
+    SharedPtr<ValueChunk> chunk_;
+    /// Offset of data in the chunk.
+    unsigned offset_ = 0;
+    /// Size of encoded data.
+    unsigned size_ = 0;
+};
+
+/// Pooled storage of encoded state values. Values are packed into small chunks. Memory of a chunk is released when
+/// all states referencing it are destroyed.
+class ValuePool
+{
+public:
+    /// Copy data into the pool.
+    EncodedValue Store(const void* data, unsigned size);
+    /// Stop appending to current chunk.
+    void Clear() { current_.Reset(); }
+
+protected:
+    /// Chunk new values are appended to.
+    SharedPtr<ValueChunk> current_;
+};
+
+/// Type tags of trackable states. Used for identifying concrete state type without runtime type information.
+enum StateType : unsigned char
+{
+    STATE_ATTRIBUTE,
+    STATE_ELEMENT_PARENT,
+    STATE_NODE_PARENT,
+    STATE_COMPONENT_PARENT,
+    STATE_XML_VARIANT,
+    STATE_XML_PARENT,
+};
+
+/// Abstract class for implementing various trackable states. States are allocated from pools shared by all states
+/// of similar size.
 class State : public RefCounted
 {
 public:
+    /// Construct.
+    explicit State(StateType stateType) : stateType_(stateType) { }
+    /// Allocate memory for a state.
+    static void* operator new(size_t size);
+    /// Release memory of a state.
+    static void operator delete(void* p, size_t size);
+
     /// Apply state saved in this object.
     virtual void Apply() = 0;
     /// Return true if state of this object matches state of specified object.
     virtual bool Equals(State* other) const = 0;
+    /// Return hash of state identity. States that are equal must return equal hashes.
+    virtual unsigned ToHash() const = 0;
     /// Return string representation of current state.
     virtual String ToString() const { return "State"; }
+    /// Return approximate amount of memory used by this state.
+    virtual unsigned GetMemoryUse() const = 0;
+    /// Release references to states of other collections. Called when older history entries are discarded.
+    virtual void Detach() { }
+    /// Write state to a journal record. Return false if state can not be journaled.
+    virtual bool Save(Serializer& dest) const { return false; }
+    /// Return true if applying this state removes item from it's parent.
+    virtual bool IsRemoval() const { return false; }
+    /// Return type tag of this state.
+    StateType GetStateType() const { return stateType_; }
+    /// Return this state cast to specified state class, or null if state is of a different type.
+    template<typename T> T* Cast() { return stateType_ == T::TYPE ? static_cast<T*>(this) : nullptr; }
+    /// Return this state cast to specified state class, or null if state is of a different type.
+    template<typename T> const T* Cast() const { return stateType_ == T::TYPE ? static_cast<const T*>(this) : nullptr; }
+
+protected:
+    /// Type tag of concrete state class.
+    StateType stateType_;
 };
 
-/// Tracks attribute values of Serializable item.
+/// Tracks attribute values of Serializable item. Values are stored encoded in a ValuePool, optionally as a patch
+/// against value of another state.
 class AttributeState : public State
 {
 public:
-    /// Construct state consisting of single attribute.
-    AttributeState(Serializable* item, const String& name, const Variant& value);
+    /// Type tag of this state class.
+    static const StateType TYPE = STATE_ATTRIBUTE;
+
+    /// Construct state consisting of single attribute. When base is specified value may be stored as difference from
+    /// value of base state.
+    AttributeState(ValuePool* pool, Serializable* item, const String& name, const Variant& value,
+        AttributeState* base=nullptr);
     /// Apply attributes if they are different and return true if operation was carried out.
     void Apply() override;
     /// Return true if state of this object matches state of specified object.
     bool Equals(State* other) const override;
+    /// Return hash of item and attribute name.
+    unsigned ToHash() const override;
     /// Return string representation of current state.
     String ToString() const override;
+    /// Return approximate amount of memory used by this state.
+    unsigned GetMemoryUse() const override;
+    /// Store value without reference to base state.
+    void Detach() override;
+    /// Write state to a journal record. Only attributes of nodes and components are journaled.
+    bool Save(Serializer& dest) const override;
+    /// Return saved attribute value.
+    Variant GetValue() const;
 
     /// Object that was modified.
     SharedPtr<Serializable> item_;
     /// Changed attribute name.
     String name_;
-    /// Changed attribute value.
+
+protected:
+    /// Write full encoded value to specified buffer.
+    void GetEncodedValue(PODVector<unsigned char>& data) const;
+
+    /// Pool encoded value is stored in.
+    ValuePool* pool_;
+    /// Type of changed attribute value.
+    VariantType type_;
+    /// Changed attribute value when it can not be encoded.
     Variant value_;
+    /// Encoded attribute value, or a patch against value of base_.
+    EncodedValue encoded_;
+    /// State which value encoded_ is a patch against.
+    SharedPtr<AttributeState> base_;
 };
 
 /// Tracks UIElement parent state. Used for tracking adding and removing UIElements.
 class ElementParentState : public State
 {
 public:
+    /// Type tag of this state class.
+    static const StateType TYPE = STATE_ELEMENT_PARENT;
+
     /// Construct item from the state and parent
     ElementParentState(UIElement* item, UIElement* parent);
     /// Set parent of the item if it is different and return true if operation was carried out.
     void Apply() override;
     /// Return true if state of this object matches state of specified object.
     bool Equals(State* other) const override;
+    /// Return hash of item and its parent.
+    unsigned ToHash() const override;
     /// Return string representation of current state.
     String ToString() const override;
+    /// Return approximate amount of memory used by this state.
+    unsigned GetMemoryUse() const override { return sizeof(*this); }
 
     /// UIElement whose state is saved.
     SharedPtr<UIElement> item_;
@@ -94,14 +210,25 @@ public:
 class NodeParentState : public State
 {
 public:
+    /// Type tag of this state class.
+    static const StateType TYPE = STATE_NODE_PARENT;
+
     /// Construct item from the state and parent
     NodeParentState(Node* item, Node* parent);
     /// Set parent of the item if it is different and return true if operation was carried out.
     void Apply() override;
     /// Return true if state of this object matches state of specified object.
     bool Equals(State* other) const override;
+    /// Return hash of item and its parent.
+    unsigned ToHash() const override;
     /// Return string representation of current state.
     String ToString() const override;
+    /// Return approximate amount of memory used by this state.
+    unsigned GetMemoryUse() const override { return sizeof(*this); }
+    /// Write state to a journal record.
+    bool Save(Serializer& dest) const override;
+    /// Return true if applying this state removes item from it's parent.
+    bool IsRemoval() const override { return parent_.Null(); }
 
     /// UIElement whose state is saved.
     SharedPtr<Node> item_;
@@ -109,20 +236,33 @@ public:
     SharedPtr<Node> parent_;
     /// Position at which item was inserted to parent's children list.
     unsigned index_ = M_MAX_UNSIGNED;
+    /// ID of the node at the time when state was saved. Node loses it's ID when it is removed from the scene.
+    unsigned id_;
 };
 
 /// Tracks Component parent state. Used for tracking adding and removing components.
 class ComponentParentState : public State
 {
 public:
+    /// Type tag of this state class.
+    static const StateType TYPE = STATE_COMPONENT_PARENT;
+
     /// Construct item from the state and parent
     ComponentParentState(Component* item, Node* parent);
     /// Set parent of the item if it is different and return true if operation was carried out.
     void Apply() override;
     /// Return true if state of this object matches state of specified object.
     bool Equals(State* other) const override;
+    /// Return hash of item and its parent.
+    unsigned ToHash() const override;
     /// Return string representation of current state.
     String ToString() const override;
+    /// Return approximate amount of memory used by this state.
+    unsigned GetMemoryUse() const override { return sizeof(*this); }
+    /// Write state to a journal record.
+    bool Save(Serializer& dest) const override;
+    /// Return true if applying this state removes item from it's parent.
+    bool IsRemoval() const override { return parent_.Null(); }
 
     /// UIElement whose state is saved.
     SharedPtr<Component> item_;
@@ -136,14 +276,21 @@ public:
 class XMLVariantState : public State
 {
 public:
+    /// Type tag of this state class.
+    static const StateType TYPE = STATE_XML_VARIANT;
+
     /// Construct item from the state and parent
     XMLVariantState(const XMLElement& item, const Variant& value);
     /// Set parent of the item if it is different and return true if operation was carried out.
     void Apply() override;
     /// Return true if state of this object matches state of specified object.
     bool Equals(State* other) const override;
+    /// Return hash of element name.
+    unsigned ToHash() const override;
     /// Return string representation of current state.
     String ToString() const override;
+    /// Return approximate amount of memory used by this state.
+    unsigned GetMemoryUse() const override { return sizeof(*this); }
 
     /// XMLElement whose state is saved.
     XMLElement item_;
@@ -155,14 +302,21 @@ public:
 class XMLParentState : public State
 {
 public:
+    /// Type tag of this state class.
+    static const StateType TYPE = STATE_XML_PARENT;
+
     /// Construct item from the state and parent.
     explicit XMLParentState(const XMLElement& item, const XMLElement& parent=XMLElement());
     /// Set parent of the item if it is different and return true if operation was carried out.
     void Apply() override;
     /// Return true if state of this object matches state of specified object.
     bool Equals(State* other) const override;
+    /// Return hash of item and its parent.
+    unsigned ToHash() const override;
     /// Return string representation of current state.
     String ToString() const override;
+    /// Return approximate amount of memory used by this state.
+    unsigned GetMemoryUse() const override { return sizeof(*this); }
 
     /// XMLElement whose state is saved.
     XMLElement item_;
@@ -170,6 +324,20 @@ public:
     XMLElement parent_;
 };
 
+/// Hash set key which compares states by their contents.
+struct StateKey
+{
+    /// Construct.
+    StateKey(State* state=nullptr) : state_(state) { }
+    /// Test for equality with another key.
+    bool operator ==(const StateKey& rhs) const { return state_->Equals(rhs.state_); }
+    /// Return hash value for HashSet.
+    unsigned ToHash() const { return state_->ToHash(); }
+
+    /// State this key refers to.
+    State* state_;
+};
+
 /// A collection of states that are applied together.
 class StateCollection
 {
@@ -180,9 +348,17 @@ public:
     bool Contains(State* other) const;
     /// Append state to the collection if such state does not already exist.
     bool PushUnique(const SharedPtr<State>& state);
+    /// Release references to states of other collections.
+    void Detach();
+    /// Release lookup table of states. Should be called when no more states will be appended to this collection.
+    void ReleaseLookup() { HashSet<StateKey> empty; lookup_.Swap(empty); }
 
     /// List of states that should be applied together.
     Vector<SharedPtr<State>> states_;
+    /// Set of states in states_ used for constant time lookup. Rebuilt on demand when it was released.
+    HashSet<StateKey> lookup_;
+    /// Approximate amount of memory used by states of this collection.
+    unsigned memoryUse_ = 0;
 };
 
 class Manager : public Object
@@ -197,6 +373,41 @@ public:
     void Redo();
     /// Clear all tracked state.
     void Clear();
+    /// Begin recording changes as a single undo step. Groups may be nested, changes are committed when outermost group
+    /// ends.
+    void BeginGroup();
+    /// End recording changes started by BeginGroup().
+    void EndGroup();
+    /// Return true if changes are being recorded as a group.
+    bool IsGroupActive() const { return groupDepth_ > 0; }
+    /// Set maximum amount of memory undo history may use. Oldest entries are discarded when limit is exceeded. 0 means
+    /// unlimited.
+    void SetMemoryBudget(unsigned bytes);
+    /// Return maximum amount of memory undo history may use.
+    unsigned GetMemoryBudget() const { return memoryBudget_; }
+    /// Set maximum number of undo steps kept in history. Oldest entries are discarded when limit is exceeded. 0 means
+    /// unlimited.
+    void SetMaxEntries(unsigned count);
+    /// Return maximum number of undo steps kept in history.
+    unsigned GetMaxEntries() const { return maxEntries_; }
+    /// Return approximate amount of memory used by undo history.
+    unsigned GetMemoryUse() const;
+    /// Return number of undo steps kept in history.
+    unsigned GetNumEntries() const { return stack_.Empty() ? 0 : stack_.Size() - 1; }
+    /// Set time window in milliseconds within which consecutive changes of the same attributes are merged into a
+    /// single undo step. 0 disables merging by time.
+    void SetCoalesceInterval(unsigned milliseconds) { coalesceInterval_ = milliseconds; }
+    /// Return time window within which consecutive changes of the same attributes are merged.
+    unsigned GetCoalesceInterval() const { return coalesceInterval_; }
+    /// Set whether consecutive changes of the same attributes are merged while any UI widget is active.
+    void SetCoalesceWhileActive(bool enable) { coalesceWhileActive_ = enable; }
+    /// Return whether consecutive changes of the same attributes are merged while any UI widget is active.
+    bool GetCoalesceWhileActive() const { return coalesceWhileActive_; }
+    /// Set journal committed changes and undo/redo operations are written to. Pass null to disable journaling.
+    void SetJournal(Journal* journal) { journal_ = journal; }
+    /// Apply changes read from a journal of previous editor session and append them to current journal. Recovered
+    /// changes are not tracked.
+    void Recover(const Vector<PODVector<unsigned char>>& records);
 
     /// Track changes performed by this scene.
     void Connect(Scene* scene);
@@ -220,15 +431,37 @@ public:
     void XMLSetVariantValue(XMLElement& element, const Variant& value);
 
 protected:
+    /// Save tracked changes as a new undo step. When allowed, changes are merged into last undo step if they modify
+    /// same attributes.
+    void Commit(bool allowCoalesce=true);
+    /// Replace new states of last undo step with tracked changes if they modify same attributes. Return true if
+    /// changes were merged.
+    bool TryCoalesce();
+    /// Return true if changes committed now may be merged into last undo step by time or because a widget is active.
+    bool IsCoalesceWindowOpen();
+    /// Journal last undo step if changes were merged into it since it was journaled.
+    void FlushJournal();
+    /// Write new states, or complete UI layout, to the journal.
+    void WriteJournal(const Vector<SharedPtr<State>>& states);
+    /// Return true if node belongs to a subtree whose removal was tracked since last commit.
+    bool IsInRemovedSubtree(Node* node) const;
     /// Apply state going to specified direction in the state stack.
     void ApplyStateFromStack(bool forward);
+    /// Discard oldest history entries until memory and entry limits are satisfied.
+    void EnforceBudget();
+    /// Write complete UI layout to a journal record.
+    bool SaveLayout(Serializer& dest) const;
+    /// Track old and new values of single attribute.
+    void TrackAttribute(Serializable* item, const String& name, const Variant& oldValue, const Variant& newValue);
     /// Track object state as old.
     template<typename T, typename... Args>
-    void TrackBefore(Args...);
+    T* TrackBefore(Args...);
     /// Track object state as new.
     template<typename T, typename... Args>
-    void TrackAfter(Args...);
+    T* TrackAfter(Args...);
 
+    /// Storage of encoded attribute values. Declared before states so it outlives them.
+    ValuePool pool_;
     /// State stack
     Vector<StateCollection> stack_;
     /// Current state index, -1 when stack is empty.
@@ -239,6 +472,49 @@ protected:
     Vector<SharedPtr<State>> previous_;
     /// List of new object states.
     Vector<SharedPtr<State>> next_;
+    /// Nodes whose removal was tracked since last commit. Changes of their subtrees are implied by removal and are not
+    /// tracked.
+    HashSet<Node*> removedNodes_;
+    /// Maximum amount of memory history may use, 0 means unlimited.
+    unsigned memoryBudget_ = 0;
+    /// Maximum number of undo steps, 0 means unlimited.
+    unsigned maxEntries_ = 0;
+    /// Number of BeginGroup() calls without matching EndGroup().
+    unsigned groupDepth_ = 0;
+    /// Time window for merging consecutive changes, 0 disables merging by time.
+    unsigned coalesceInterval_ = 0;
+    /// Flag indicating that changes are merged while any UI widget is active.
+    bool coalesceWhileActive_ = false;
+    /// Flag indicating that last undo step consists of attribute changes only and may absorb further changes.
+    bool lastCommitCoalescible_ = false;
+    /// Time since last commit.
+    Timer coalesceTimer_;
+    /// Flag indicating that changes were merged into last undo step and it was not journaled since.
+    bool journalPending_ = false;
+    /// Journal changes are written to.
+    WeakPtr<Journal> journal_;
+    /// Tracked scene.
+    WeakPtr<Scene> scene_;
+    /// Root of tracked UI hierarchy.
+    WeakPtr<UIElement> root_;
+};
+
+/// Records all changes performed during lifetime of this object as a single undo step.
+class Group
+{
+public:
+    /// Begin recording changes.
+    explicit Group(Manager& manager) : manager_(manager) { manager_.BeginGroup(); }
+    /// End recording changes.
+    ~Group() { manager_.EndGroup(); }
+    /// Prevent copy construction.
+    Group(const Group&) = delete;
+    /// Prevent assignment.
+    Group& operator =(const Group&) = delete;
+
+protected:
+    /// Manager recording the changes.
+    Manager& manager_;
 };
 
 }
@@ -0,0 +1,186 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/GraphicsEvents.h>
+#include <Urho3D/Graphics/Light.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/RenderPath.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Graphics/Viewport.h>
+#include <Urho3D/Graphics/Zone.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "PreviewRenderer.h"
+
+
+namespace Urho3D
+{
+
+/// Sizes of pooled render targets.
+static const int PREVIEW_TARGET_SIZES[] = {64, 128, 256, 512};
+/// Maximum number of unused render targets of one size kept in the pool.
+static const unsigned PREVIEW_TARGET_POOL_SIZE = 4;
+
+PreviewRenderer::PreviewRenderer(Context* context)
+    : Object(context)
+{
+    scene_ = new Scene(context_);
+    scene_->CreateComponent<Octree>();
+    auto zone = scene_->CreateComponent<Zone>();
+    zone->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
+    zone->SetAmbientColor(Color(0.4f, 0.4f, 0.4f));
+
+    cameraNode_ = scene_->CreateChild("Camera");
+    auto camera = cameraNode_->CreateComponent<Camera>();
+    light_ = cameraNode_->CreateComponent<Light>();
+    light_->SetLightType(LIGHT_DIRECTIONAL);
+    previewNode_ = scene_->CreateChild("Preview");
+    previewNode_->CreateComponent<StaticModel>();
+
+    viewport_ = new Viewport(context_, scene_, camera);
+
+    SubscribeToEvent(E_ENDRENDERING, [&](StringHash, VariantMap&) { OnEndRendering(); });
+    // Reloaded materials, techniques and textures change how previews look.
+    SubscribeToEvent(E_RELOADFINISHED, [&](StringHash, VariantMap&) { resourceRevision_++; });
+}
+
+PreviewRenderer* PreviewRenderer::GetOrCreate(Context* context)
+{
+    auto renderer = context->GetSubsystem<PreviewRenderer>();
+    if (renderer == nullptr)
+    {
+        renderer = new PreviewRenderer(context);
+        context->RegisterSubsystem(renderer);
+    }
+    return renderer;
+}
+
+int PreviewRenderer::GetTargetSize(int size)
+{
+    int bucket = PREVIEW_TARGET_SIZES[0];
+    for (int targetSize : PREVIEW_TARGET_SIZES)
+    {
+        bucket = targetSize;
+        if (targetSize >= size)
+            break;
+    }
+    return bucket;
+}
+
+SharedPtr<Texture2D> PreviewRenderer::AcquireTarget(int size)
+{
+    int bucket = GetTargetSize(size);
+
+    Vector<SharedPtr<Texture2D>>& free = freeTargets_[bucket];
+    if (!free.Empty())
+    {
+        SharedPtr<Texture2D> target = free.Back();
+        free.Pop();
+        return target;
+    }
+
+    SharedPtr<Texture2D> target(new Texture2D(context_));
+    target->SetNumLevels(1);
+    target->SetSize(bucket, bucket, Graphics::GetRGBAFormat(), TEXTURE_RENDERTARGET);
+    target->GetRenderSurface()->SetViewport(0, viewport_);
+    target->GetRenderSurface()->SetUpdateMode(SURFACE_MANUALUPDATE);
+    return target;
+}
+
+void PreviewRenderer::ReleaseTarget(Texture2D* target)
+{
+    if (target == nullptr)
+        return;
+
+    Vector<SharedPtr<Texture2D>>& free = freeTargets_[target->GetWidth()];
+    if (free.Size() < PREVIEW_TARGET_POOL_SIZE)
+        free.Push(SharedPtr<Texture2D>(target));
+}
+
+bool PreviewRenderer::RenderPreview(Texture2D* target, Model* model, Material* material, float modelScale,
+    const Quaternion& cameraRotation, float cameraDistance, RenderPath* renderPath)
+{
+    // Only one preview is rendered per frame, scene must not change until it is rendered.
+    if (renderTarget_ || target == nullptr || model == nullptr)
+        return false;
+
+    auto staticModel = previewNode_->GetComponent<StaticModel>();
+    staticModel->SetModel(model);
+    staticModel->SetMaterial(material);
+
+    // Fit model into a unit cube centered in front of the camera.
+    BoundingBox bounds = staticModel->GetBoundingBox();
+    float scale = modelScale / Max(Max(bounds.Size().x_, bounds.Size().y_), Max(bounds.Size().z_, M_EPSILON));
+    previewNode_->SetScale(scale);
+    previewNode_->SetPosition(-bounds.Center() * scale);
+
+    cameraNode_->SetPosition(cameraRotation * Vector3::BACK * cameraDistance);
+    cameraNode_->SetRotation(cameraRotation);
+
+    // Render path of preview must be same as render path of the viewport material is used in.
+    bool physical = false;
+    viewport_->SetRenderPath(renderPath);
+    if (renderPath != nullptr)
+    {
+        for (const auto& command : renderPath->commands_)
+        {
+            if (command.pixelShaderName_ == "PBRDeferred")
+            {
+                physical = true;
+                break;
+            }
+        }
+    }
+
+    // Lights in PBR scenes need modifications, otherwise objects in material preview look very dark.
+    light_->SetUsePhysicalValues(physical);
+    light_->SetBrightness(physical ? 5000.0f : 1.0f);
+    if (physical)
+        light_->SetShadowCascade(CascadeParameters(10, 20, 30, 40, 10));
+
+    renderTarget_ = target;
+    target->GetRenderSurface()->QueueUpdate();
+    return true;
+}
+
+void PreviewRenderer::OnEndRendering()
+{
+    // Rendering may be skipped, for example when window is minimized.
+    if (renderTarget_ && renderTarget_->GetRenderSurface()->IsUpdateQueued())
+        return;
+
+    // Previewed resources are not kept alive by the preview scene.
+    auto staticModel = previewNode_->GetComponent<StaticModel>();
+    if (staticModel->GetModel() != nullptr)
+    {
+        staticModel->SetModel(nullptr);
+        staticModel->SetMaterial(nullptr);
+    }
+    renderTarget_.Reset();
+}
+
+}
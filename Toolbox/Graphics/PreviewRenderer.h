@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+
+
+namespace Urho3D
+{
+
+class Light;
+class Material;
+class Model;
+class Node;
+class RenderPath;
+class Scene;
+class Texture2D;
+class Viewport;
+
+/// Renders previews of models and materials on demand, for interactive material previews as well as for thumbnails.
+/// All previews share one scene and one preview is rendered per frame, therefore previews are rendered only when
+/// something they show changes. Render targets are pooled in a few fixed
+/// size buckets, so resizing a preview does not reallocate textures.
+class PreviewRenderer : public Object
+{
+    URHO3D_OBJECT(PreviewRenderer, Object);
+public:
+    /// Construct.
+    explicit PreviewRenderer(Context* context);
+
+    /// Return preview renderer subsystem, registering it if it does not exist yet.
+    static PreviewRenderer* GetOrCreate(Context* context);
+    /// Return size of render target used for a preview of specified size.
+    static int GetTargetSize(int size);
+    /// Return render target at least as big as specified size, up to the biggest bucket size.
+    SharedPtr<Texture2D> AcquireTarget(int size);
+    /// Return render target to the pool.
+    void ReleaseTarget(Texture2D* target);
+    /// Queue rendering of a model with a material applied, or with default material when material is null. Model is
+    /// scaled to fit a unit cube and scale is multiplied by modelScale. Camera orbits the model at specified distance.
+    /// Null render path means default render path. Return false if another preview is being rendered this frame,
+    /// caller should try again next frame. Rendering is finished when update of target's render surface is no longer
+    /// queued.
+    bool RenderPreview(Texture2D* target, Model* model, Material* material, float modelScale,
+        const Quaternion& cameraRotation, float cameraDistance, RenderPath* renderPath);
+    /// Return revision of resources. Revision changes whenever a resource previews may depend on is reloaded.
+    unsigned GetResourceRevision() const { return resourceRevision_; }
+
+protected:
+    /// Finish rendering of a preview.
+    void OnEndRendering();
+
+    /// Scene in which previews are rendered.
+    SharedPtr<Scene> scene_;
+    /// Node holding previewed model.
+    WeakPtr<Node> previewNode_;
+    /// Node holding camera and light.
+    WeakPtr<Node> cameraNode_;
+    /// Light illuminating previewed model.
+    WeakPtr<Light> light_;
+    /// Viewport rendering preview scene to all render targets.
+    SharedPtr<Viewport> viewport_;
+    /// Unused render targets keyed by size.
+    HashMap<int, Vector<SharedPtr<Texture2D>>> freeTargets_;
+    /// Render target of preview being rendered this frame.
+    WeakPtr<Texture2D> renderTarget_;
+    /// Revision of resources.
+    unsigned resourceRevision_ = 0;
+};
+
+}
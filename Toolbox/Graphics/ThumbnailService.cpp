@@ -0,0 +1,338 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/GraphicsEvents.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "PreviewRenderer.h"
+#include "ThumbnailService.h"
+
+
+namespace Urho3D
+{
+
+/// Time in milliseconds worker thread sleeps when there is nothing to do.
+static const unsigned THUMBNAIL_WORKER_INTERVAL = 10;
+/// Model materials are previewed on.
+static const char* THUMBNAIL_MATERIAL_MODEL = "Models/Sphere.mdl";
+/// Distance of camera from previewed model.
+static const float THUMBNAIL_CAMERA_DISTANCE = 1.5f;
+
+ThumbnailService::ThumbnailService(Context* context)
+    : Object(context)
+{
+    // Models and materials are rendered by preview renderer shared with other previews.
+    renderer_ = PreviewRenderer::GetOrCreate(context_);
+    SetThumbnailSize(size_);
+
+    SubscribeToEvent(E_BEGINFRAME, [&](StringHash, VariantMap&) { OnBeginFrame(); });
+    SubscribeToEvent(E_ENDRENDERING, [&](StringHash, VariantMap&) { OnEndRendering(); });
+    SubscribeToEvent(E_FILECHANGED, [&](StringHash, VariantMap& args) {
+        // Changed resource gets a new hash, old thumbnail is not used anymore.
+        thumbnails_.Erase(args[FileChanged::P_RESOURCENAME].GetString());
+    });
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, [&](StringHash, VariantMap& args) {
+        using namespace ResourceBackgroundLoaded;
+        auto it = loading_.Find(args[P_RESOURCENAME].GetString());
+        if (it == loading_.End())
+            return;
+
+        if (args[P_SUCCESS].GetBool())
+        {
+            it->second_.resource_ = static_cast<Resource*>(args[P_RESOURCE].GetPtr());
+            renderQueue_.Push(it->second_);
+        }
+        loading_.Erase(it);
+    });
+
+    Run();
+}
+
+ThumbnailService::~ThumbnailService()
+{
+    Stop();
+    if (renderer_)
+        renderer_->ReleaseTarget(renderTarget_);
+}
+
+Texture2D* ThumbnailService::GetThumbnail(const String& resourceName)
+{
+    auto it = thumbnails_.Find(resourceName);
+    if (it != thumbnails_.End())
+        return it->second_;
+
+    // Entry is created right away so resource is queued only once, even when thumbnail can not be created.
+    thumbnails_.Insert(MakePair(resourceName, SharedPtr<Texture2D>()));
+
+    if (cacheDir_.Empty())
+        return nullptr;
+
+    ThumbnailJob job;
+    job.type_ = GetContentType(context_, resourceName);
+    if (job.type_ != CTYPE_MODEL && job.type_ != CTYPE_MATERIAL && job.type_ != CTYPE_TEXTURE)
+        return nullptr;
+
+    // Resources stored in packages are not supported.
+    job.fileName_ = GetSubsystem<ResourceCache>()->GetResourceFileName(resourceName);
+    if (job.fileName_.Empty())
+        return nullptr;
+
+    job.resourceName_ = resourceName;
+    job.cacheDir_ = cacheDir_;
+    job.size_ = size_;
+    job.image_ = new Image(context_);
+
+    MutexLock lock(mutex_);
+    jobs_.Push(job);
+    job.image_.Reset();
+    return nullptr;
+}
+
+void ThumbnailService::SetCacheDir(const String& cacheDir)
+{
+    cacheDir_ = AddTrailingSlash(cacheDir);
+    GetSubsystem<FileSystem>()->CreateDir(cacheDir_);
+}
+
+void ThumbnailService::SetThumbnailSize(int size)
+{
+    size_ = Max(size, 1);
+    thumbnails_.Clear();
+    if (renderer_)
+    {
+        renderer_->ReleaseTarget(renderTarget_);
+        renderTarget_ = renderer_->AcquireTarget(size_);
+    }
+}
+
+void ThumbnailService::ThreadFunction()
+{
+    while (shouldRun_)
+    {
+        ThumbnailJob job;
+        {
+            MutexLock lock(mutex_);
+            if (!jobs_.Empty())
+            {
+                job = jobs_.Front();
+                jobs_.PopFront();
+            }
+        }
+
+        if (job.resourceName_.Empty())
+        {
+            Time::Sleep(THUMBNAIL_WORKER_INTERVAL);
+            continue;
+        }
+
+        if (job.save_)
+            job.image_->SavePNG(job.cachePath_);
+        else
+            ProcessJob(job);
+
+        // Job is returned to main thread even when there is nothing left to do, so image is destroyed there.
+        MutexLock lock(mutex_);
+        results_.Push(job);
+        job = ThumbnailJob();
+    }
+}
+
+void ThumbnailService::ProcessJob(ThumbnailJob& job)
+{
+    File file(context_, job.fileName_);
+    if (!file.IsOpen())
+        return;
+
+    PODVector<unsigned char> data(file.GetSize());
+    if (file.Read(data.Buffer(), data.Size()) != data.Size())
+        return;
+
+    // Thumbnails are cached by contents, so renamed or copied resources reuse existing thumbnails.
+    unsigned hash = 0;
+    for (unsigned char c : data)
+        hash = SDBMHash(hash, c);
+    job.cachePath_ = job.cacheDir_ + ToString("%08X_%08X_%d.png", hash, data.Size(), job.size_);
+
+    Image* image = job.image_;
+    File cached(context_);
+    if (cached.Open(job.cachePath_, FILE_READ) && image->Load(cached))
+    {
+        job.loaded_ = true;
+        return;
+    }
+
+    if (job.type_ != CTYPE_TEXTURE)
+    {
+        job.render_ = true;
+        return;
+    }
+
+    MemoryBuffer buffer(data);
+    if (!image->Load(buffer) || image->IsCompressed() || image->GetDepth() > 1)
+        return;
+
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+    if (width > job.size_ || height > job.size_)
+    {
+        float scale = (float)job.size_ / Max(width, height);
+        image->Resize(Max((int)(width * scale), 1), Max((int)(height * scale), 1));
+    }
+    image->SavePNG(job.cachePath_);
+    job.loaded_ = true;
+}
+
+void ThumbnailService::OnBeginFrame()
+{
+    HiresTimer timer;
+    while (timer.GetUSec(false) < frameBudget_ * 1000LL)
+    {
+        ThumbnailJob job;
+        {
+            MutexLock lock(mutex_);
+            if (results_.Empty())
+                break;
+            job = results_.Front();
+            results_.PopFront();
+        }
+
+        // Saved thumbnails need no further processing. Thumbnail may also be discarded while it was being created.
+        if (job.save_ || !thumbnails_.Contains(job.resourceName_))
+            continue;
+
+        if (job.loaded_)
+            SetThumbnail(job.resourceName_, job.image_);
+        else if (job.render_)
+        {
+            job.image_.Reset();
+            RequestRender(job);
+        }
+    }
+
+    // Only one preview is rendered per frame.
+    if (!rendering_.resourceName_.Empty() || renderer_.Null())
+        return;
+
+    while (!renderQueue_.Empty())
+    {
+        const ThumbnailJob& job = renderQueue_.Front();
+        Model* model = nullptr;
+        Material* material = nullptr;
+        if (!thumbnails_.Contains(job.resourceName_) || !GetPreviewModel(job, model, material))
+        {
+            renderQueue_.PopFront();
+            continue;
+        }
+
+        // Renderer is busy when another preview is rendered this frame, job is retried next frame.
+        if (renderer_->RenderPreview(renderTarget_, model, material, 1.0f, Quaternion::IDENTITY,
+            THUMBNAIL_CAMERA_DISTANCE, nullptr))
+        {
+            rendering_ = job;
+            renderQueue_.PopFront();
+        }
+        break;
+    }
+}
+
+void ThumbnailService::OnEndRendering()
+{
+    if (rendering_.resourceName_.Empty())
+        return;
+
+    // Rendering may be skipped, for example when window is minimized.
+    if (renderTarget_ && renderTarget_->GetRenderSurface()->IsUpdateQueued())
+        return;
+
+    ThumbnailJob job = rendering_;
+    rendering_ = ThumbnailJob();
+
+    job.image_ = renderTarget_ ? renderTarget_->GetImage() : SharedPtr<Image>();
+    if (job.image_.Null())
+        return;
+    // Pooled render target may be bigger than thumbnail.
+    if (job.image_->GetWidth() != size_ || job.image_->GetHeight() != size_)
+        job.image_->Resize(size_, size_);
+
+    if (thumbnails_.Contains(job.resourceName_))
+        SetThumbnail(job.resourceName_, job.image_);
+
+    // Encoding is done by worker thread.
+    job.resource_.Reset();
+    job.save_ = true;
+    MutexLock lock(mutex_);
+    jobs_.Push(job);
+    job = ThumbnailJob();
+}
+
+void ThumbnailService::RequestRender(ThumbnailJob& job)
+{
+    auto cache = GetSubsystem<ResourceCache>();
+    StringHash type = job.type_ == CTYPE_MODEL ? Model::GetTypeStatic() : Material::GetTypeStatic();
+    if (cache->GetExistingResource(type, job.resourceName_) == nullptr)
+        cache->BackgroundLoadResource(type, job.resourceName_);
+
+    // Background loading falls back to loading immediately when threading is not supported.
+    if (Resource* resource = cache->GetExistingResource(type, job.resourceName_))
+    {
+        job.resource_ = resource;
+        renderQueue_.Push(job);
+    }
+    else
+        loading_[job.resourceName_] = job;
+}
+
+bool ThumbnailService::GetPreviewModel(const ThumbnailJob& job, Model*& model, Material*& material)
+{
+    if (job.type_ == CTYPE_MODEL)
+    {
+        model = static_cast<Model*>(job.resource_.Get());
+        material = nullptr;
+    }
+    else
+    {
+        model = GetSubsystem<ResourceCache>()->GetResource<Model>(THUMBNAIL_MATERIAL_MODEL);
+        material = static_cast<Material*>(job.resource_.Get());
+    }
+    return model != nullptr;
+}
+
+void ThumbnailService::SetThumbnail(const String& resourceName, Image* image)
+{
+    SharedPtr<Texture2D> texture(new Texture2D(context_));
+    texture->SetNumLevels(1);
+    if (texture->SetData(image, true))
+        thumbnails_[resourceName] = texture;
+}
+
+}
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/List.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Thread.h>
+#include "IO/ContentUtilities.h"
+
+
+namespace Urho3D
+{
+
+class Image;
+class Material;
+class Model;
+class PreviewRenderer;
+class Resource;
+class Texture2D;
+
+/// Work item of thumbnail service.
+struct ThumbnailJob
+{
+    /// Name of resource thumbnail is created for.
+    String resourceName_;
+    /// Absolute file name of the resource.
+    String fileName_;
+    /// Content type of the resource.
+    ContentType type_ = CTYPE_UNKNOWN;
+    /// Directory thumbnails are cached in.
+    String cacheDir_;
+    /// Width and height of thumbnail.
+    int size_ = 0;
+    /// File name of cached thumbnail. Set by worker thread.
+    String cachePath_;
+    /// Thumbnail image. Image objects are created and destroyed on main thread only, worker thread fills them.
+    SharedPtr<Image> image_;
+    /// Flag indicating that image_ holds a thumbnail loaded from cache or created by worker thread.
+    bool loaded_ = false;
+    /// Flag indicating that thumbnail must be rendered on main thread.
+    bool render_ = false;
+    /// Flag indicating that image_ should only be written to cachePath_.
+    bool save_ = false;
+    /// Resource being previewed. Set when resource was loaded on main thread.
+    SharedPtr<Resource> resource_;
+};
+
+/// Creates preview images of models, materials and textures. Thumbnails are cached on disk under a hash of resource
+/// contents. Reading and hashing resources, loading cached thumbnails and scaling textures is done by a worker
+/// thread. Models and materials are loaded in background and rendered on main thread, one per frame. Uploading
+/// finished thumbnails is limited by a per-frame time budget, therefore requesting a thumbnail never blocks. Jobs are
+/// handed between threads only while holding a lock, so reference counts of shared objects are never modified
+/// concurrently.
+class ThumbnailService : public Object, public Thread
+{
+    URHO3D_OBJECT(ThumbnailService, Object);
+public:
+    /// Construct.
+    explicit ThumbnailService(Context* context);
+    /// Destruct.
+    ~ThumbnailService() override;
+
+    /// Return thumbnail of a resource. If thumbnail is not ready it is queued for creation and null is returned.
+    /// Null is also returned for resources whose thumbnails can not be created.
+    Texture2D* GetThumbnail(const String& resourceName);
+    /// Set directory thumbnails are cached in.
+    void SetCacheDir(const String& cacheDir);
+    /// Return directory thumbnails are cached in.
+    const String& GetCacheDir() const { return cacheDir_; }
+    /// Set width and height of thumbnails. Existing thumbnails are discarded.
+    void SetThumbnailSize(int size);
+    /// Return width and height of thumbnails.
+    int GetThumbnailSize() const { return size_; }
+    /// Set maximum time in milliseconds spent on uploading finished thumbnails every frame.
+    void SetFrameBudget(unsigned milliseconds) { frameBudget_ = milliseconds; }
+    /// Return maximum time in milliseconds spent on uploading finished thumbnails every frame.
+    unsigned GetFrameBudget() const { return frameBudget_; }
+
+protected:
+    /// Process queued jobs.
+    void ThreadFunction() override;
+    /// Hash resource contents, then load cached thumbnail or create thumbnail of a texture.
+    void ProcessJob(ThumbnailJob& job);
+    /// Upload finished thumbnails and start rendering next one.
+    void OnBeginFrame();
+    /// Read back rendered thumbnail.
+    void OnEndRendering();
+    /// Start loading resource that must be rendered.
+    void RequestRender(ThumbnailJob& job);
+    /// Return model and material a resource is previewed with. Return false if resource can not be previewed.
+    bool GetPreviewModel(const ThumbnailJob& job, Model*& model, Material*& material);
+    /// Create texture of finished thumbnail.
+    void SetThumbnail(const String& resourceName, Image* image);
+
+    /// Directory thumbnails are cached in.
+    String cacheDir_;
+    /// Width and height of thumbnails.
+    int size_ = 128;
+    /// Maximum time in milliseconds spent on uploading finished thumbnails every frame.
+    unsigned frameBudget_ = 2;
+    /// Thumbnails of requested resources. Null while thumbnail is being created or when it can not be created.
+    HashMap<String, SharedPtr<Texture2D>> thumbnails_;
+    /// Jobs waiting for worker thread.
+    List<ThumbnailJob> jobs_;
+    /// Jobs finished by worker thread.
+    List<ThumbnailJob> results_;
+    /// Lock protecting jobs_ and results_.
+    Mutex mutex_;
+    /// Jobs whose resources are loaded in background.
+    HashMap<String, ThumbnailJob> loading_;
+    /// Jobs whose resources are loaded and are waiting to be rendered.
+    List<ThumbnailJob> renderQueue_;
+    /// Job being rendered this frame.
+    ThumbnailJob rendering_;
+    /// Renderer of model and material previews.
+    WeakPtr<PreviewRenderer> renderer_;
+    /// Pooled render target previews are rendered to.
+    SharedPtr<Texture2D> renderTarget_;
+};
+
+}
@@ -25,6 +25,10 @@
 #include <Toolbox/SystemUI/SystemUI.h>
 #include "ContentUtilities.h"
 
+#include <cassert>
+#include <sys/stat.h>
+#include <sys/types.h>
+
 
 namespace Urho3D
 {
@@ -36,6 +40,27 @@ const Vector<String> imagesExtensions_{".png", ".jpg", ".jpeg", ".gif", ".ttf",
 const Vector<String> textExtensions_{".xml", ".json", ".txt"};
 const Vector<String> audioExtensions_{".waw", ".ogg", ".mp3"};
 
+/// Maximum number of bytes read from the beginning of xml file when looking for root element.
+static const unsigned ROOT_TAG_SNIFF_LIMIT = 4096;
+/// Number of bytes read at once when looking for root element.
+static const unsigned ROOT_TAG_SNIFF_CHUNK = 256;
+/// Version of content type cache file format.
+static const unsigned CONTENT_TYPE_CACHE_VERSION = 1;
+
+/// Content type of a file and properties of the file at the time type was determined.
+struct CachedContentType
+{
+    /// Modification time of the file.
+    unsigned modified_;
+    /// Size of the file.
+    unsigned size_;
+    /// Content type of the file.
+    ContentType type_;
+};
+
+/// Content types of xml files keyed by absolute file name. Accessed only from the main thread.
+static HashMap<String, CachedContentType> contentTypeCache_;
+
 FileType GetFileType(const String& fileName)
 {
     auto extension = GetExtension(fileName).ToLower();
@@ -90,29 +115,158 @@ String GetFileIcon(const String& fileName)
 ContentType GetContentType(const String& resourcePath)
 {
     SystemUI* systemUI = static_cast<SystemUI*>(ui::GetIO().UserData);
-    auto extension = GetExtension(resourcePath).ToLower();
-    if (extension == ".xml")
+    return GetContentType(systemUI->GetContext(), resourcePath);
+}
+
+bool GetFileStats(const String& fileName, unsigned& modified, unsigned& size)
+{
+#ifdef _WIN32
+    struct _stat st;
+    if (_wstat(WString(GetNativePath(fileName)).CString(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(GetNativePath(fileName).CString(), &st) != 0)
+        return false;
+#endif
+    if ((st.st_mode & S_IFMT) != S_IFREG)
+        return false;
+
+    modified = (unsigned)st.st_mtime;
+    size = (unsigned)st.st_size;
+    return true;
+}
+
+/// Find name of root element in the beginning of xml document. Return false if more data is needed. Tag is empty if
+/// text is not a xml document.
+static bool FindRootTag(const String& text, String& tag)
+{
+    auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+
+    tag.Clear();
+    unsigned length = text.Length();
+    unsigned i = text.StartsWith("\xEF\xBB\xBF") ? 3 : 0;
+    for (;;)
     {
-        SharedPtr<XMLFile> xml(systemUI->GetSubsystem<ResourceCache>()->GetResource<XMLFile>(resourcePath));
-        auto rootElementName = xml->GetRoot().GetName();
-        if (rootElementName == "scene")
-            return CTYPE_SCENE;
-        if (rootElementName == "node")
-            return CTYPE_SCENEOBJECT;
-        if (rootElementName == "elements")
-            return CTYPE_UISTYLE;
-        if (rootElementName == "element")
-            return CTYPE_UILAYOUT;
-        if (rootElementName == "material")
-            return CTYPE_MATERIAL;
-        if (rootElementName == "particleeffect")
-            return CTYPE_PARTICLE;
-        if (rootElementName == "renderpath")
-            return CTYPE_RENDERPATH;
-        if (rootElementName == "texture")
-            return CTYPE_TEXTUREXML;
+        while (i < length && isSpace(text[i]))
+            i++;
+        if (i + 1 >= length)
+            return false;
+        if (text[i] != '<')
+            return true;
+
+        // Skip declaration, processing instructions, comments and doctype.
+        const char* terminator = nullptr;
+        if (text[i + 1] == '?')
+            terminator = "?>";
+        else if (text[i + 1] == '!')
+        {
+            if (i + 4 > length)
+                return false;
+            terminator = text.Substring(i, 4) == "<!--" ? "-->" : ">";
+        }
+
+        if (terminator != nullptr)
+        {
+            unsigned end = text.Find(terminator, i + 2);
+            if (end == String::NPOS)
+                return false;
+            i = end + String::CStringLength(terminator);
+            continue;
+        }
+
+        unsigned start = i + 1;
+        unsigned end = start;
+        while (end < length && !isSpace(text[end]) && text[end] != '>' && text[end] != '/')
+            end++;
+        if (end >= length)
+            return false;
+
+        tag = text.Substring(start, end - start);
+        return true;
     }
+}
 
+/// Return name of root element of xml document by reading only the beginning of it. Return empty string if root
+/// element was not found.
+static String SniffRootTag(Deserializer& source)
+{
+    String text;
+    String tag;
+    char buffer[ROOT_TAG_SNIFF_CHUNK];
+    while (text.Length() < ROOT_TAG_SNIFF_LIMIT && !source.IsEof())
+    {
+        unsigned size = source.Read(buffer, sizeof(buffer));
+        if (size == 0)
+            break;
+        text.Append(buffer, size);
+        if (FindRootTag(text, tag))
+            return tag;
+    }
+    return String::EMPTY;
+}
+
+/// Return content type of xml document with specified root element.
+static ContentType GetContentTypeByRootTag(const String& rootElementName)
+{
+    if (rootElementName == "scene")
+        return CTYPE_SCENE;
+    if (rootElementName == "node")
+        return CTYPE_SCENEOBJECT;
+    if (rootElementName == "elements")
+        return CTYPE_UISTYLE;
+    if (rootElementName == "element")
+        return CTYPE_UILAYOUT;
+    if (rootElementName == "material")
+        return CTYPE_MATERIAL;
+    if (rootElementName == "particleeffect")
+        return CTYPE_PARTICLE;
+    if (rootElementName == "renderpath")
+        return CTYPE_RENDERPATH;
+    if (rootElementName == "texture")
+        return CTYPE_TEXTUREXML;
+    return CTYPE_UNKNOWN;
+}
+
+ContentType GetContentTypeOfXMLText(const String& text)
+{
+    String tag;
+    FindRootTag(text, tag);
+    return GetContentTypeByRootTag(tag);
+}
+
+/// Return content type of xml document. Document is not loaded as a resource, only it's beginning is read. Results
+/// are memoized by file name, modification time and size.
+static ContentType GetXMLContentType(Context* context, const String& resourcePath)
+{
+    assert(Thread::IsMainThread());
+    auto cache = context->GetSubsystem<ResourceCache>();
+
+    String fileName = IsAbsolutePath(resourcePath) ? resourcePath : cache->GetResourceFileName(resourcePath);
+    unsigned modified = 0;
+    unsigned size = 0;
+    if (fileName.Empty() || !GetFileStats(fileName, modified, size))
+    {
+        // Resource is stored in a package file.
+        SharedPtr<File> file(cache->GetFile(resourcePath, false));
+        return file ? GetContentTypeByRootTag(SniffRootTag(*file)) : CTYPE_UNKNOWN;
+    }
+
+    auto it = contentTypeCache_.Find(fileName);
+    if (it != contentTypeCache_.End() && it->second_.modified_ == modified && it->second_.size_ == size)
+        return it->second_.type_;
+
+    File file(context, fileName);
+    ContentType type = file.IsOpen() ? GetContentTypeByRootTag(SniffRootTag(file)) : CTYPE_UNKNOWN;
+    contentTypeCache_[fileName] = {modified, size, type};
+    return type;
+}
+
+ContentType GetContentType(Context* context, const String& resourcePath)
+{
+    auto extension = GetExtension(resourcePath).ToLower();
+    if (extension == ".xml")
+        return GetXMLContentType(context, resourcePath);
     if (extension == ".mdl")
         return CTYPE_MODEL;
     if (extension == ".ani")
@@ -125,4 +279,60 @@ ContentType GetContentType(const String& resourcePath)
     return CTYPE_UNKNOWN;
 }
 
+bool LoadContentTypeCache(Context* context, const String& fileName)
+{
+    File file(context);
+    if (!file.Open(fileName, FILE_READ))
+        return false;
+
+    if (file.ReadFileID() != "CTYP" || file.ReadUInt() != CONTENT_TYPE_CACHE_VERSION)
+        return false;
+
+    unsigned count = file.ReadVLE();
+    for (unsigned i = 0; i < count && !file.IsEof(); i++)
+    {
+        String name = file.ReadString();
+        CachedContentType entry;
+        entry.modified_ = file.ReadUInt();
+        entry.size_ = file.ReadUInt();
+        entry.type_ = (ContentType)file.ReadUByte();
+        if (!name.Empty())
+            contentTypeCache_[name] = entry;
+    }
+    return true;
+}
+
+bool SaveContentTypeCache(Context* context, const String& fileName)
+{
+    File file(context);
+    if (!file.Open(fileName, FILE_WRITE))
+        return false;
+
+    // Files that no longer exist are dropped.
+    VectorBuffer entries;
+    unsigned count = 0;
+    unsigned modified, size;
+    for (const auto& entry : contentTypeCache_)
+    {
+        if (!GetFileStats(entry.first_, modified, size))
+            continue;
+
+        entries.WriteString(entry.first_);
+        entries.WriteUInt(entry.second_.modified_);
+        entries.WriteUInt(entry.second_.size_);
+        entries.WriteUByte((unsigned char)entry.second_.type_);
+        count++;
+    }
+
+    file.WriteFileID("CTYP");
+    file.WriteUInt(CONTENT_TYPE_CACHE_VERSION);
+    file.WriteVLE(count);
+    return file.Write(entries.GetData(), entries.GetSize()) == entries.GetSize();
+}
+
+void ClearContentTypeCache()
+{
+    contentTypeCache_.Clear();
+}
+
 }
@@ -30,6 +30,8 @@
 namespace Urho3D
 {
 
+class Context;
+
 enum FileType
 {
     FTYPE_FILE,
@@ -68,7 +70,23 @@ FileType GetFileType(const String& fileName);
 /// Return icon from icon font based on extension of file name.
 String GetFileIcon(const String& fileName);
 
-/// Return content type by inspecting file contents.
+/// Return content type of a file using context of SystemUI. May be called only from the main thread.
 ContentType GetContentType(const String& resourcePath);
+/// Return content type of a file. Xml files are classified by root element name read from the beginning of the file,
+/// file is located through ResourceCache of specified context. Results are memoized by file modification time and
+/// size in a global cache, therefore this function may be called only from the main thread.
+ContentType GetContentType(Context* context, const String& resourcePath);
+/// Return content type of xml document text. Only the beginning of the text is inspected. Does not access any
+/// subsystems and may be called from worker threads.
+ContentType GetContentTypeOfXMLText(const String& text);
+/// Retrieve modification time and size of a file. Return false if file does not exist. May be called from worker
+/// threads.
+bool GetFileStats(const String& fileName, unsigned& modified, unsigned& size);
+/// Load content types of files determined in previous sessions.
+bool LoadContentTypeCache(Context* context, const String& fileName);
+/// Save content types of files so they do not have to be determined again in next session.
+bool SaveContentTypeCache(Context* context, const String& fileName);
+/// Forget content types of all files.
+void ClearContentTypeCache();
 
 }
@@ -0,0 +1,565 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <cstdio>
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "ResourceDependencyGraph.h"
+
+
+namespace Urho3D
+{
+
+/// Version of saved graph format.
+static const unsigned DEPENDENCY_GRAPH_VERSION = 1;
+/// Number of files scanned by one work item.
+static const unsigned PARSE_BATCH_SIZE = 128;
+/// Quoted strings longer than this are not considered to be resource names.
+static const unsigned MAX_REFERENCE_LENGTH = 1024;
+/// Returned when resource has no dependencies.
+static const Vector<String> noResources;
+
+/// Return true if file may reference other resources and should be scanned.
+static bool IsScannable(const String& resourceName)
+{
+    String extension = GetExtension(resourceName);
+    return extension == ".xml" || extension == ".json";
+}
+
+/// Return true if xml document of specified type may reference other resources.
+static bool IsScannable(ContentType type)
+{
+    switch (type)
+    {
+    case CTYPE_SCENE:
+    case CTYPE_SCENEOBJECT:
+    case CTYPE_UILAYOUT:
+    case CTYPE_UISTYLE:
+    case CTYPE_MATERIAL:
+    case CTYPE_PARTICLE:
+    case CTYPE_RENDERPATH:
+    case CTYPE_TEXTUREXML:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Read contents of a file without creating any objects, so that it may be used from worker threads.
+static bool ReadText(const String& fileName, String& text)
+{
+#ifdef _WIN32
+    FILE* file = _wfopen(WString(GetNativePath(fileName)).CString(), L"rb");
+#else
+    FILE* file = fopen(GetNativePath(fileName).CString(), "rb");
+#endif
+    if (file == nullptr)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    bool success = size >= 0;
+    if (success && size == 0)
+        text.Clear();
+    else if (success)
+    {
+        text.Resize((unsigned)size);
+        success = fread(&text[0], 1, (size_t)size, file) == (size_t)size;
+    }
+    fclose(file);
+    return success;
+}
+
+ResourceDependencyGraph::ResourceDependencyGraph(Context* context)
+    : Object(context)
+{
+    // Resource directories are scanned on first frame, so that saved graph may be loaded before that.
+    SubscribeToEvent(E_BEGINFRAME, [&](StringHash, VariantMap&) { OnBeginFrame(); });
+    SubscribeToEvent(E_FILECHANGED, [&](StringHash, VariantMap& args) {
+        OnFileChanged(args[FileChanged::P_RESOURCENAME].GetString());
+    });
+}
+
+ResourceDependencyGraph::~ResourceDependencyGraph()
+{
+    // Worker threads must not access destroyed tasks.
+    WaitForScan();
+}
+
+void ResourceDependencyGraph::Rebuild()
+{
+    WaitForScan();
+
+    auto fs = GetSubsystem<FileSystem>();
+    auto queue = GetSubsystem<WorkQueue>();
+
+    resourceDirs_ = GetSubsystem<ResourceCache>()->GetResourceDirs();
+    pendingChanges_.Clear();
+
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        SharedPtr<ListTask> task(new ListTask());
+        task->fileSystem_ = fs;
+        task->resourceDir_ = resourceDir;
+        task->item_ = new WorkItem();
+        task->item_->workFunction_ = ListResourceDir;
+        task->item_->aux_ = task.Get();
+        // Lowest priority, so that frame rendering never waits for the scan.
+        task->item_->priority_ = 0;
+        listTasks_.Push(task);
+        queue->AddWorkItem(task->item_);
+    }
+}
+
+const Vector<String>& ResourceDependencyGraph::GetUses(const String& resourceName) const
+{
+    auto it = files_.Find(resourceName);
+    return it != files_.End() ? it->second_.uses_ : noResources;
+}
+
+const Vector<String>& ResourceDependencyGraph::GetUsedBy(const String& resourceName) const
+{
+    auto it = usedBy_.Find(resourceName);
+    return it != usedBy_.End() ? it->second_ : noResources;
+}
+
+void ResourceDependencyGraph::GetAllUsedBy(const String& resourceName, Vector<String>& result) const
+{
+    result.Clear();
+
+    HashSet<String> visited;
+    visited.Insert(resourceName);
+    Vector<String> queue;
+    queue.Push(resourceName);
+    for (unsigned i = 0; i < queue.Size(); i++)
+    {
+        // Resource may be referenced through a chain, like texture used by a material used by a scene.
+        for (const auto& user : GetUsedBy(queue[i]))
+        {
+            if (visited.Contains(user))
+                continue;
+            visited.Insert(user);
+            queue.Push(user);
+            result.Push(user);
+        }
+    }
+}
+
+bool ResourceDependencyGraph::Load(const String& fileName)
+{
+    WaitForScan();
+
+    File file(context_);
+    if (!file.Open(fileName, FILE_READ))
+        return false;
+
+    if (file.ReadFileID() != "RDEP" || file.ReadUInt() != DEPENDENCY_GRAPH_VERSION)
+        return false;
+
+    files_.Clear();
+    usedBy_.Clear();
+
+    unsigned count = file.ReadVLE();
+    for (unsigned i = 0; i < count && !file.IsEof(); i++)
+    {
+        String resourceName = file.ReadString();
+        ResourceDependencies& dependencies = files_[resourceName];
+        dependencies.fileName_ = file.ReadString();
+        dependencies.modified_ = file.ReadUInt();
+        dependencies.size_ = file.ReadUInt();
+        dependencies.contentType_ = (ContentType)file.ReadUByte();
+        dependencies.uses_.Resize(file.ReadVLE());
+        for (auto& use : dependencies.uses_)
+            use = file.ReadString();
+        LinkFile(resourceName, dependencies);
+    }
+
+    // Loaded graph is verified by scanning resource directories again.
+    resourceDirs_.Clear();
+    return true;
+}
+
+bool ResourceDependencyGraph::Save(const String& fileName)
+{
+    File file(context_);
+    if (!file.Open(fileName, FILE_WRITE))
+        return false;
+
+    VectorBuffer entries;
+    for (const auto& entry : files_)
+    {
+        const ResourceDependencies& dependencies = entry.second_;
+        entries.WriteString(entry.first_);
+        entries.WriteString(dependencies.fileName_);
+        entries.WriteUInt(dependencies.modified_);
+        entries.WriteUInt(dependencies.size_);
+        entries.WriteUByte((unsigned char)dependencies.contentType_);
+        entries.WriteVLE(dependencies.uses_.Size());
+        for (const auto& use : dependencies.uses_)
+            entries.WriteString(use);
+    }
+
+    file.WriteFileID("RDEP");
+    file.WriteUInt(DEPENDENCY_GRAPH_VERSION);
+    file.WriteVLE(files_.Size());
+    return file.Write(entries.GetData(), entries.GetSize()) == entries.GetSize();
+}
+
+void ResourceDependencyGraph::ListResourceDir(const WorkItem* item, unsigned threadIndex)
+{
+    auto task = static_cast<ListTask*>(item->aux_);
+
+    Vector<String> files;
+    task->fileSystem_->ScanDir(files, task->resourceDir_, "", SCAN_FILES, true);
+    for (const auto& file : files)
+    {
+        if (IsScannable(file))
+            task->files_.Push(file);
+    }
+}
+
+void ResourceDependencyGraph::ParseFiles(const WorkItem* item, unsigned threadIndex)
+{
+    auto task = static_cast<ParseTask*>(item->aux_);
+
+    // Most files reference the same few resources, their existence is checked once per batch.
+    HashMap<String, bool> existingFiles;
+    task->results_.Resize(task->resourceNames_.Size());
+    for (unsigned i = 0; i < task->resourceNames_.Size(); i++)
+    {
+        if (!task->graph_->ParseFile(task->fileSystem_, task->resourceNames_[i], task->fileNames_[i],
+            task->results_[i], existingFiles))
+            task->results_[i].fileName_.Clear();
+    }
+}
+
+bool ResourceDependencyGraph::ParseFile(FileSystem* fs, const String& resourceName, const String& fileName,
+    ResourceDependencies& dependencies, HashMap<String, bool>& existingFiles) const
+{
+    unsigned modified = 0;
+    unsigned size = 0;
+    if (!GetFileStats(fileName, modified, size))
+        return false;
+
+    auto it = files_.Find(resourceName);
+    if (it != files_.End() && it->second_.fileName_ == fileName && it->second_.modified_ == modified &&
+        it->second_.size_ == size)
+    {
+        dependencies = it->second_;
+        return true;
+    }
+
+    dependencies.fileName_ = fileName;
+    dependencies.modified_ = modified;
+    dependencies.size_ = size;
+    dependencies.contentType_ = CTYPE_UNKNOWN;
+    dependencies.uses_.Clear();
+
+    String text;
+    if (!ReadText(fileName, text))
+        return false;
+
+    if (GetExtension(fileName) == ".xml")
+    {
+        dependencies.contentType_ = GetContentTypeOfXMLText(text);
+        if (!IsScannable(dependencies.contentType_))
+            return true;
+    }
+
+    // Resources are referenced by quoted attribute values in xml and by string values in json. Values are either
+    // resource names or resource references, which are type name followed by resource names separated by semicolons.
+    HashSet<String> found;
+    unsigned position = 0;
+    for (;;)
+    {
+        unsigned start = text.Find('"', position);
+        if (start == String::NPOS)
+            break;
+        unsigned end = start + 1;
+        while (end < text.Length() && text[end] != '"')
+            end += text[end] == '\\' ? 2 : 1;
+        if (end >= text.Length())
+            break;
+        position = end + 1;
+
+        unsigned length = end - start - 1;
+        if (length == 0 || length > MAX_REFERENCE_LENGTH)
+            continue;
+
+        Vector<String> names = text.Substring(start + 1, length).Split(';');
+        unsigned first = names.Size() > 1 && !names[0].Contains('.') && !names[0].Contains('/') ? 1 : 0;
+        for (unsigned i = first; i < names.Size(); i++)
+        {
+            String name = names[i].Trimmed();
+            if (name.Empty() || name == resourceName || GetExtension(name).Empty() || found.Contains(name))
+                continue;
+
+            auto exists = existingFiles.Find(name);
+            if (exists == existingFiles.End())
+            {
+                bool fileExists = false;
+                for (unsigned j = 0; j < resourceDirs_.Size() && !fileExists; j++)
+                    fileExists = fs->FileExists(resourceDirs_[j] + name);
+                exists = existingFiles.Insert(MakePair(name, fileExists));
+            }
+
+            if (exists->second_)
+            {
+                found.Insert(name);
+                dependencies.uses_.Push(name);
+            }
+        }
+    }
+    return true;
+}
+
+void ResourceDependencyGraph::WaitForScan()
+{
+    if (listTasks_.Empty() && parseTasks_.Empty())
+        return;
+
+    // Work that did not start yet is cancelled and only running work is waited for, other work of the queue is not
+    // completed here.
+    if (auto queue = GetSubsystem<WorkQueue>())
+    {
+        PODVector<WorkItem*> items;
+        for (const auto& task : listTasks_)
+            items.Push(task->item_);
+        for (const auto& task : parseTasks_)
+            items.Push(task->item_);
+
+        for (WorkItem* item : items)
+        {
+            if (!queue->RemoveWorkItem(SharedPtr<WorkItem>(item)))
+            {
+                while (!item->completed_)
+                    Time::Sleep(0);
+            }
+        }
+    }
+    listTasks_.Clear();
+    parseTasks_.Clear();
+}
+
+void ResourceDependencyGraph::StartParsing()
+{
+    auto fs = GetSubsystem<FileSystem>();
+    auto queue = GetSubsystem<WorkQueue>();
+
+    // When a file exists in multiple resource directories, the one found first is used, same as ResourceCache does.
+    HashSet<String> names;
+    SharedPtr<ParseTask> task;
+    for (const auto& listTask : listTasks_)
+    {
+        for (const auto& file : listTask->files_)
+        {
+            if (names.Contains(file))
+                continue;
+            names.Insert(file);
+
+            if (task.Null() || task->resourceNames_.Size() >= PARSE_BATCH_SIZE)
+            {
+                task = new ParseTask();
+                task->graph_ = this;
+                task->fileSystem_ = fs;
+                task->item_ = new WorkItem();
+                task->item_->workFunction_ = ParseFiles;
+                task->item_->aux_ = task.Get();
+                task->item_->priority_ = 0;
+                parseTasks_.Push(task);
+            }
+            task->resourceNames_.Push(file);
+            task->fileNames_.Push(listTask->resourceDir_ + file);
+        }
+    }
+    listTasks_.Clear();
+
+    // Work is queued only after all batches are created, because it reads results of the previous scan.
+    for (const auto& parseTask : parseTasks_)
+        queue->AddWorkItem(parseTask->item_);
+
+    if (parseTasks_.Empty())
+        FinishParsing();
+}
+
+void ResourceDependencyGraph::FinishParsing()
+{
+    files_.Clear();
+    usedBy_.Clear();
+    for (const auto& task : parseTasks_)
+    {
+        for (unsigned i = 0; i < task->resourceNames_.Size(); i++)
+        {
+            const ResourceDependencies& dependencies = task->results_[i];
+            if (dependencies.fileName_.Empty())
+                continue;
+            files_[task->resourceNames_[i]] = dependencies;
+            LinkFile(task->resourceNames_[i], dependencies);
+        }
+    }
+    parseTasks_.Clear();
+
+    Vector<String> changes;
+    changes.Swap(pendingChanges_);
+    for (const auto& change : changes)
+        OnFileChanged(change);
+}
+
+void ResourceDependencyGraph::OnFileChanged(const String& resourceName)
+{
+    if (!IsReady())
+    {
+        pendingChanges_.Push(resourceName);
+        return;
+    }
+
+    auto fs = GetSubsystem<FileSystem>();
+    String name = RemoveTrailingSlash(GetInternalPath(resourceName));
+
+    // Changed item may be a directory. It is scanned, because watchers do not always report changes of directory
+    // contents individually.
+    bool isDirectory = false;
+    Vector<String> files;
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        if (!fs->DirExists(resourceDir + name))
+            continue;
+
+        isDirectory = true;
+        files.Clear();
+        fs->ScanDir(files, resourceDir + name, "", SCAN_FILES, true);
+        for (const auto& file : files)
+        {
+            if (IsScannable(file))
+                UpdateFile(name + "/" + file);
+        }
+    }
+
+    if (isDirectory)
+        return;
+
+    if (IsScannable(name))
+    {
+        UpdateFile(name);
+        return;
+    }
+
+    // Removed directory takes all files in it along.
+    String dirPrefix = name + "/";
+    Vector<String> removed;
+    for (const auto& entry : files_)
+    {
+        if (entry.first_.StartsWith(dirPrefix))
+            removed.Push(entry.first_);
+    }
+    for (const auto& file : removed)
+        RemoveFile(file);
+}
+
+void ResourceDependencyGraph::UpdateFile(const String& resourceName)
+{
+    auto fs = GetSubsystem<FileSystem>();
+
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        if (!fs->FileExists(resourceDir + resourceName))
+            continue;
+
+        HashMap<String, bool> existingFiles;
+        ResourceDependencies dependencies;
+        if (ParseFile(fs, resourceName, resourceDir + resourceName, dependencies, existingFiles))
+            SetDependencies(resourceName, dependencies);
+        else
+            RemoveFile(resourceName);
+        return;
+    }
+
+    RemoveFile(resourceName);
+}
+
+void ResourceDependencyGraph::SetDependencies(const String& resourceName, const ResourceDependencies& dependencies)
+{
+    RemoveFile(resourceName);
+    files_[resourceName] = dependencies;
+    LinkFile(resourceName, dependencies);
+}
+
+void ResourceDependencyGraph::RemoveFile(const String& resourceName)
+{
+    auto it = files_.Find(resourceName);
+    if (it == files_.End())
+        return;
+
+    for (const auto& use : it->second_.uses_)
+    {
+        auto users = usedBy_.Find(use);
+        if (users == usedBy_.End())
+            continue;
+        users->second_.Remove(resourceName);
+        if (users->second_.Empty())
+            usedBy_.Erase(users);
+    }
+    files_.Erase(it);
+}
+
+void ResourceDependencyGraph::LinkFile(const String& resourceName, const ResourceDependencies& dependencies)
+{
+    for (const auto& use : dependencies.uses_)
+        usedBy_[use].Push(resourceName);
+}
+
+void ResourceDependencyGraph::OnBeginFrame()
+{
+    if (GetSubsystem<ResourceCache>()->GetResourceDirs() != resourceDirs_)
+        Rebuild();
+
+    if (!listTasks_.Empty())
+    {
+        for (const auto& task : listTasks_)
+        {
+            if (!task->item_->completed_)
+                return;
+        }
+        StartParsing();
+    }
+
+    if (!parseTasks_.Empty())
+    {
+        for (const auto& task : parseTasks_)
+        {
+            if (!task->item_->completed_)
+                return;
+        }
+        FinishParsing();
+    }
+}
+
+}
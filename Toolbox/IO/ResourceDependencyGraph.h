@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include "IO/ContentUtilities.h"
+
+
+namespace Urho3D
+{
+
+class FileSystem;
+
+/// Resources referenced by a file.
+struct ResourceDependencies
+{
+    /// Absolute name of the file.
+    String fileName_;
+    /// Modification time of the file when it was scanned.
+    unsigned modified_ = 0;
+    /// Size of the file when it was scanned.
+    unsigned size_ = 0;
+    /// Content type of the file.
+    ContentType contentType_ = CTYPE_UNKNOWN;
+    /// Names of referenced resources.
+    Vector<String> uses_;
+};
+
+/// Graph of references between resources. Scenes, prefabs, materials, UI layouts and styles, particle effects, render
+/// paths and texture parameter files, as well as all json files, are scanned for names of existing resources. Resource
+/// directories are scanned in parallel on worker threads, afterwards graph is updated incrementally as ResourceCache
+/// reports file changes. Graph may be saved and loaded, files that did not change since are not scanned again.
+class ResourceDependencyGraph : public Object
+{
+    URHO3D_OBJECT(ResourceDependencyGraph, Object);
+public:
+    /// Construct.
+    explicit ResourceDependencyGraph(Context* context);
+    /// Destruct.
+    ~ResourceDependencyGraph() override;
+
+    /// Rescan all resource directories.
+    void Rebuild();
+    /// Return true when resource directories are scanned. Graph loaded from a file may be queried before that.
+    bool IsReady() const { return listTasks_.Empty() && parseTasks_.Empty(); }
+    /// Return names of resources referenced by a resource.
+    const Vector<String>& GetUses(const String& resourceName) const;
+    /// Return names of resources referencing a resource.
+    const Vector<String>& GetUsedBy(const String& resourceName) const;
+    /// Return names of resources referencing a resource directly or through other resources.
+    void GetAllUsedBy(const String& resourceName, Vector<String>& result) const;
+
+    /// Load graph saved in previous session. Resource directories are scanned again, but only changed files are
+    /// parsed.
+    bool Load(const String& fileName);
+    /// Save graph.
+    bool Save(const String& fileName);
+
+protected:
+    /// Listing of scannable files in one resource directory built on worker thread.
+    struct ListTask : public RefCounted
+    {
+        /// File system used for listing.
+        FileSystem* fileSystem_ = nullptr;
+        /// Resource directory.
+        String resourceDir_;
+        /// Resource names of scannable files.
+        Vector<String> files_;
+        /// Work item listing the directory.
+        SharedPtr<WorkItem> item_;
+    };
+
+    /// Batch of files scanned on worker thread.
+    struct ParseTask : public RefCounted
+    {
+        /// Graph whose resource directories and previous results are used. They are not modified while tasks run.
+        const ResourceDependencyGraph* graph_ = nullptr;
+        /// File system used for checking existence of referenced resources.
+        FileSystem* fileSystem_ = nullptr;
+        /// Resource names of files.
+        Vector<String> resourceNames_;
+        /// Absolute names of files.
+        Vector<String> fileNames_;
+        /// Dependencies of files.
+        Vector<ResourceDependencies> results_;
+        /// Work item scanning the files.
+        SharedPtr<WorkItem> item_;
+    };
+
+    /// List scannable files of a resource directory. Executed on worker thread.
+    static void ListResourceDir(const WorkItem* item, unsigned threadIndex);
+    /// Scan batch of files. Executed on worker thread.
+    static void ParseFiles(const WorkItem* item, unsigned threadIndex);
+    /// Scan a file for references to existing resources. Return false if file could not be read.
+    bool ParseFile(FileSystem* fs, const String& resourceName, const String& fileName,
+        ResourceDependencies& dependencies, HashMap<String, bool>& existingFiles) const;
+    /// Cancel work that did not start yet and block until running work is finished.
+    void WaitForScan();
+    /// Split listed files into batches and start scanning them.
+    void StartParsing();
+    /// Replace graph with results of scanned files.
+    void FinishParsing();
+    /// Rescan changed file or directory.
+    void OnFileChanged(const String& resourceName);
+    /// Rescan a file and update it's references.
+    void UpdateFile(const String& resourceName);
+    /// Replace references of a file.
+    void SetDependencies(const String& resourceName, const ResourceDependencies& dependencies);
+    /// Remove file and references made by it.
+    void RemoveFile(const String& resourceName);
+    /// Add references of a file to the reverse index.
+    void LinkFile(const String& resourceName, const ResourceDependencies& dependencies);
+    /// Start scanning, process finished work and queued changes.
+    void OnBeginFrame();
+
+    /// Resource directories graph was built from.
+    Vector<String> resourceDirs_;
+    /// References made by scanned files keyed by resource name.
+    HashMap<String, ResourceDependencies> files_;
+    /// Resources referencing a resource keyed by resource name of referenced resource.
+    HashMap<String, Vector<String>> usedBy_;
+    /// Listings in progress.
+    Vector<SharedPtr<ListTask>> listTasks_;
+    /// Scans in progress.
+    Vector<SharedPtr<ParseTask>> parseTasks_;
+    /// Changes reported while resource directories are being scanned.
+    Vector<String> pendingChanges_;
+};
+
+}
@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/FileWatcher.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "ResourceDirectoryIndex.h"
+
+
+namespace Urho3D
+{
+
+ResourceDirectoryIndex::ResourceDirectoryIndex(Context* context)
+    : Object(context)
+{
+    SubscribeToEvent(E_BEGINFRAME, [&](StringHash, VariantMap&) { OnBeginFrame(); });
+    // ResourceCache watches resource directories on it's own when auto-reload is enabled.
+    SubscribeToEvent(E_FILECHANGED, [&](StringHash, VariantMap& args) {
+        OnFileChanged(args[FileChanged::P_RESOURCENAME].GetString());
+    });
+}
+
+ResourceDirectoryIndex::~ResourceDirectoryIndex() = default;
+
+const DirectoryListing& ResourceDirectoryIndex::GetListing(const String& path)
+{
+    UpdateWatchers();
+
+    auto it = listings_.Find(path);
+    if (it == listings_.End())
+    {
+        it = listings_.Insert(MakePair(path, DirectoryListing()));
+        BuildListing(path, it->second_);
+        it->second_.revision_ = ++lastRevision_;
+    }
+    return it->second_;
+}
+
+void ResourceDirectoryIndex::Invalidate(const String& path)
+{
+    listings_.Erase(path);
+}
+
+void ResourceDirectoryIndex::InvalidateAll()
+{
+    listings_.Clear();
+}
+
+void ResourceDirectoryIndex::BuildListing(const String& path, DirectoryListing& listing)
+{
+    auto fs = GetSubsystem<FileSystem>();
+
+    HashSet<String> dirs;
+    HashSet<String> files;
+    Vector<String> items;
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        String fullPath = resourceDir + path;
+        listing.modifiedTimes_.Push(fs->GetLastModifiedTime(fullPath));
+
+        items.Clear();
+        fs->ScanDir(items, fullPath, "", SCAN_FILES, false);
+        for (const auto& item : items)
+        {
+            if (files.Contains(item))
+                continue;
+            files.Insert(item);
+            listing.files_.Push(item);
+        }
+
+        items.Clear();
+        fs->ScanDir(items, fullPath, "", SCAN_DIRS, false);
+        for (const auto& item : items)
+        {
+            if (item == "." || item == ".." || dirs.Contains(item))
+                continue;
+            dirs.Insert(item);
+            listing.dirs_.Push(item);
+        }
+    }
+
+    Sort(listing.dirs_.Begin(), listing.dirs_.End());
+    Sort(listing.files_.Begin(), listing.files_.End());
+}
+
+void ResourceDirectoryIndex::OnFileChanged(const String& resourceName)
+{
+    // Changed item may be a file or a directory, in both cases listing of it's parent changes. Directory itself is
+    // rescanned as well, because watchers do not always report changes of directory contents individually.
+    String name = GetInternalPath(resourceName);
+    Invalidate(GetParentPath(name));
+    Invalidate(AddTrailingSlash(name));
+}
+
+void ResourceDirectoryIndex::UpdateWatchers()
+{
+    auto cache = GetSubsystem<ResourceCache>();
+    bool watchedByCache = cache->GetAutoReloadResources();
+    if (cache->GetResourceDirs() == resourceDirs_ && watchedByCache == watchedByCache_)
+        return;
+
+    resourceDirs_ = cache->GetResourceDirs();
+    watchedByCache_ = watchedByCache;
+    InvalidateAll();
+    watchers_.Clear();
+    polling_ = false;
+
+    if (watchedByCache_)
+        return;
+
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        SharedPtr<FileWatcher> watcher(new FileWatcher(context_));
+        if (watcher->StartWatching(resourceDir, true))
+            watchers_.Push(watcher);
+        else
+            polling_ = true;
+    }
+}
+
+void ResourceDirectoryIndex::Poll()
+{
+    auto fs = GetSubsystem<FileSystem>();
+
+    for (auto it = listings_.Begin(); it != listings_.End();)
+    {
+        bool modified = false;
+        for (unsigned i = 0; i < resourceDirs_.Size() && !modified; i++)
+            modified = fs->GetLastModifiedTime(resourceDirs_[i] + it->first_) != it->second_.modifiedTimes_[i];
+
+        if (modified)
+            it = listings_.Erase(it);
+        else
+            ++it;
+    }
+}
+
+void ResourceDirectoryIndex::OnBeginFrame()
+{
+    // Resource directories may be changed or auto-reload may be toggled.
+    UpdateWatchers();
+
+    String fileName;
+    for (auto& watcher : watchers_)
+    {
+        while (watcher->GetNextChange(fileName))
+            OnFileChanged(fileName);
+    }
+
+    if (polling_ && pollTimer_.GetMSec(false) >= pollInterval_)
+    {
+        pollTimer_.Reset();
+        Poll();
+    }
+}
+
+}
@@ -0,0 +1,104 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+
+namespace Urho3D
+{
+
+class FileWatcher;
+
+/// Sorted contents of a directory merged from all resource directories.
+struct DirectoryListing
+{
+    /// Names of subdirectories.
+    Vector<String> dirs_;
+    /// Names of files.
+    Vector<String> files_;
+    /// Modification times of scanned directories, one for every resource directory. Used when polling for changes.
+    PODVector<unsigned> modifiedTimes_;
+    /// Unique number of this listing. Rebuilt listing gets a new number, therefore data derived from a listing may be
+    /// cached until revision changes.
+    unsigned revision_ = 0;
+};
+
+/// Cache of resource directory listings. Listing of a path is built once and kept until a change inside that
+/// directory is reported by a file watcher, ResourceCache auto-reload or, when file watchers are not available, by
+/// polling directory modification times.
+class ResourceDirectoryIndex : public Object
+{
+    URHO3D_OBJECT(ResourceDirectoryIndex, Object);
+public:
+    /// Construct.
+    explicit ResourceDirectoryIndex(Context* context);
+    /// Destruct.
+    ~ResourceDirectoryIndex() override;
+
+    /// Return listing of directory relative to resource directories. Path must be empty or end with a slash.
+    const DirectoryListing& GetListing(const String& path);
+    /// Discard listing of a directory.
+    void Invalidate(const String& path);
+    /// Discard listings of all directories.
+    void InvalidateAll();
+    /// Set interval of polling directory modification times. Polling is used only when file watchers are not
+    /// available.
+    void SetPollInterval(unsigned milliseconds) { pollInterval_ = milliseconds; }
+    /// Return interval of polling directory modification times.
+    unsigned GetPollInterval() const { return pollInterval_; }
+
+protected:
+    /// Scan directory in all resource directories.
+    void BuildListing(const String& path, DirectoryListing& listing);
+    /// Discard listing of directory containing changed file.
+    void OnFileChanged(const String& resourceName);
+    /// Restart watching when set of resource directories or ResourceCache auto-reload setting changes.
+    void UpdateWatchers();
+    /// Discard listings whose directories were modified since they were built.
+    void Poll();
+    /// Process reported changes.
+    void OnBeginFrame();
+
+    /// Cached listings keyed by relative directory path.
+    HashMap<String, DirectoryListing> listings_;
+    /// Resource directories listings were built from.
+    Vector<String> resourceDirs_;
+    /// File watchers of resource directories. Not used when ResourceCache watches them already.
+    Vector<SharedPtr<FileWatcher>> watchers_;
+    /// Flag indicating that ResourceCache watches resource directories and reports changes.
+    bool watchedByCache_ = false;
+    /// Flag indicating that some resource directories can not be watched and must be polled.
+    bool polling_ = false;
+    /// Interval of polling directory modification times.
+    unsigned pollInterval_ = 1000;
+    /// Time since last poll.
+    Timer pollTimer_;
+    /// Revision of last built listing.
+    unsigned lastRevision_ = 0;
+};
+
+}
@@ -0,0 +1,195 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Audio/Sound.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/Animation.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/ParticleEffect.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Resource/JSONFile.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include "IO/ContentUtilities.h"
+#include "IO/ResourceDependencyGraph.h"
+#include "ResourcePreloader.h"
+
+
+namespace Urho3D
+{
+
+/// Return type resource is loaded as when it is opened, or StringHash::ZERO if it is not loaded through ResourceCache.
+static StringHash GetPreloadType(Context* context, const String& resourceName)
+{
+    switch (GetContentType(context, resourceName))
+    {
+    case CTYPE_SCENE:
+    case CTYPE_SCENEOBJECT:
+    case CTYPE_UISTYLE:
+    case CTYPE_RENDERPATH:
+        return XMLFile::GetTypeStatic();
+    case CTYPE_MODEL:
+        return Model::GetTypeStatic();
+    case CTYPE_ANIMATION:
+        return Animation::GetTypeStatic();
+    case CTYPE_MATERIAL:
+        return Material::GetTypeStatic();
+    case CTYPE_PARTICLE:
+        return ParticleEffect::GetTypeStatic();
+    case CTYPE_SOUND:
+        return Sound::GetTypeStatic();
+    case CTYPE_TEXTURE:
+        return Texture2D::GetTypeStatic();
+    default:
+        // Json content is not classified, but scenes may be stored as json.
+        if (GetExtension(resourceName) == ".json")
+            return JSONFile::GetTypeStatic();
+        // UI layouts are read from file directly when opened.
+        return StringHash::ZERO;
+    }
+}
+
+ResourcePreloader::ResourcePreloader(Context* context)
+    : Object(context)
+{
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, [&](StringHash, VariantMap& args) {
+        using namespace ResourceBackgroundLoaded;
+        if (args[P_SUCCESS].GetBool())
+            OnResourceLoaded(args[P_RESOURCENAME].GetString(), static_cast<Resource*>(args[P_RESOURCE].GetPtr()));
+        else
+            OnResourceFailed(args[P_RESOURCENAME].GetString());
+    });
+    // Budget is not enforced from the event above, because background loader still references the resource then.
+    SubscribeToEvent(E_BEGINFRAME, [&](StringHash, VariantMap&) {
+        if (memoryUse_ > memoryBudget_)
+            ReleaseOverBudget();
+    });
+}
+
+void ResourcePreloader::Preload(const String& resourceName)
+{
+    PreloadResource(resourceName);
+    if (auto graph = GetSubsystem<ResourceDependencyGraph>())
+    {
+        for (const auto& dependency : graph->GetUses(resourceName))
+            PreloadResource(dependency);
+    }
+    ReleaseOverBudget();
+}
+
+void ResourcePreloader::SetMemoryBudget(unsigned long long bytes)
+{
+    memoryBudget_ = bytes;
+    ReleaseOverBudget();
+}
+
+void ResourcePreloader::PreloadResource(const String& resourceName)
+{
+    StringHash type = GetPreloadType(context_, resourceName);
+    if (type == StringHash::ZERO)
+        return;
+
+    // Resources that are loaded already were not loaded speculatively and are not tracked.
+    auto cache = GetSubsystem<ResourceCache>();
+    if (cache->GetExistingResource(type, resourceName) != nullptr)
+        return;
+
+    for (const auto& resource : resources_)
+    {
+        if (resource.type_ == type && resource.name_ == resourceName)
+            return;
+    }
+
+    PreloadedResource resource;
+    resource.type_ = type;
+    resource.name_ = resourceName;
+    resources_.Push(resource);
+
+    // Background loading falls back to loading immediately when threading is not supported.
+    bool queued = cache->BackgroundLoadResource(type, resourceName);
+    if (Resource* existing = cache->GetExistingResource(type, resourceName))
+        OnResourceLoaded(resourceName, existing);
+    else if (!queued)
+        OnResourceFailed(resourceName);
+}
+
+void ResourcePreloader::OnResourceLoaded(const String& resourceName, Resource* resource)
+{
+    for (auto& preloaded : resources_)
+    {
+        if (preloaded.loaded_ || preloaded.name_ != resourceName || preloaded.type_ != resource->GetType())
+            continue;
+
+        preloaded.loaded_ = true;
+        preloaded.memoryUse_ = resource->GetMemoryUse();
+        memoryUse_ += preloaded.memoryUse_;
+        return;
+    }
+}
+
+void ResourcePreloader::OnResourceFailed(const String& resourceName)
+{
+    for (unsigned i = 0; i < resources_.Size(); i++)
+    {
+        if (!resources_[i].loaded_ && resources_[i].name_ == resourceName)
+        {
+            resources_.Erase(i);
+            return;
+        }
+    }
+}
+
+void ResourcePreloader::ReleaseOverBudget()
+{
+    auto cache = GetSubsystem<ResourceCache>();
+
+    // Resources still being loaded are skipped, their memory use is not known yet.
+    for (unsigned i = 0; i < resources_.Size();)
+    {
+        const PreloadedResource& resource = resources_[i];
+        if (!resource.loaded_)
+        {
+            i++;
+            continue;
+        }
+
+        // Resource that got used, for example by an opened scene, or was released elsewhere is no longer speculative.
+        Resource* existing = cache->GetExistingResource(resource.type_, resource.name_);
+        bool speculative = existing != nullptr && existing->Refs() == 1;
+        if (speculative && memoryUse_ <= memoryBudget_)
+        {
+            i++;
+            continue;
+        }
+
+        if (speculative)
+            cache->ReleaseResource(resource.type_, resource.name_);
+        memoryUse_ -= resource.memoryUse_;
+        resources_.Erase(i);
+    }
+}
+
+}
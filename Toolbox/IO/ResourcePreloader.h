@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+
+#include <Urho3D/Core/Object.h>
+
+
+namespace Urho3D
+{
+
+/// Loads resources in background before they are needed, so that opening them later mostly hits ResourceCache.
+/// Preloading is speculative, therefore memory used by preloaded resources is limited. When limit is exceeded, oldest
+/// preloaded resources are released from ResourceCache unless something else uses them by then.
+class ResourcePreloader : public Object
+{
+    URHO3D_OBJECT(ResourcePreloader, Object);
+public:
+    /// Construct.
+    explicit ResourcePreloader(Context* context);
+
+    /// Queue background loading of a resource and resources it references directly. References are known only when
+    /// ResourceDependencyGraph subsystem is registered.
+    void Preload(const String& resourceName);
+    /// Set maximum amount of memory in bytes used by preloaded resources.
+    void SetMemoryBudget(unsigned long long bytes);
+    /// Return maximum amount of memory in bytes used by preloaded resources.
+    unsigned long long GetMemoryBudget() const { return memoryBudget_; }
+    /// Return amount of memory in bytes used by preloaded resources.
+    unsigned long long GetMemoryUse() const { return memoryUse_; }
+
+protected:
+    /// Resource loaded speculatively.
+    struct PreloadedResource
+    {
+        /// Resource type.
+        StringHash type_;
+        /// Resource name.
+        String name_;
+        /// Memory used by resource. Known once it is loaded.
+        unsigned memoryUse_ = 0;
+        /// Flag indicating that background loading finished.
+        bool loaded_ = false;
+    };
+
+    /// Queue background loading of a single resource unless it is loaded already.
+    void PreloadResource(const String& resourceName);
+    /// Record memory use of a preloaded resource.
+    void OnResourceLoaded(const String& resourceName, Resource* resource);
+    /// Stop tracking a resource that failed to load, so that it may be preloaded again.
+    void OnResourceFailed(const String& resourceName);
+    /// Stop tracking resources that are in use and release oldest unused preloaded resources until memory use is within
+    /// budget.
+    void ReleaseOverBudget();
+
+    /// Preloaded resources, oldest first.
+    Vector<PreloadedResource> resources_;
+    /// Maximum amount of memory used by preloaded resources.
+    unsigned long long memoryBudget_ = 64 * 1024 * 1024;
+    /// Amount of memory used by preloaded resources.
+    unsigned long long memoryUse_ = 0;
+};
+
+}
@@ -0,0 +1,268 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Input/InputEvents.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/Resource.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "ResourceSaver.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdio>
+#endif
+
+
+namespace Urho3D
+{
+
+/// Time in milliseconds before saving a resource is retried after writing it's file failed.
+static const unsigned RESOURCE_SAVE_RETRY_INTERVAL = 5000;
+
+/// Replace destination file with source file. Destination is never left partially written.
+static bool ReplaceFile(const String& source, const String& destination)
+{
+#ifdef _WIN32
+    return MoveFileExW(WString(GetNativePath(source)).CString(), WString(GetNativePath(destination)).CString(),
+        MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(GetNativePath(source).CString(), GetNativePath(destination).CString()) == 0;
+#endif
+}
+
+/// Delete a file. Used for cleaning up temporary files from worker threads.
+static void RemoveFile(const String& fileName)
+{
+#ifdef _WIN32
+    DeleteFileW(WString(GetNativePath(fileName)).CString());
+#else
+    remove(GetNativePath(fileName).CString());
+#endif
+}
+
+ResourceSaver::ResourceSaver(Context* context)
+    : Object(context)
+{
+    SubscribeToEvent(E_BEGINFRAME, [&](StringHash, VariantMap&) { OnBeginFrame(); });
+    SubscribeToEvent(E_INPUTFOCUS, [&](StringHash, VariantMap& args) {
+        if (!args[InputFocus::P_FOCUS].GetBool())
+            Flush();
+    });
+    SubscribeToEvent(E_FILECHANGED, [&](StringHash, VariantMap& args) {
+        ignoredReloads_.Erase(args[FileChanged::P_RESOURCENAME].GetString());
+    });
+}
+
+ResourceSaver::~ResourceSaver()
+{
+    // Worker threads must not write to destroyed tasks.
+    Flush(true);
+}
+
+void ResourceSaver::MarkDirty(Resource* resource)
+{
+    if (resource == nullptr || resource->GetName().Empty())
+        return;
+
+    DirtyResource& dirty = dirty_[resource->GetName()];
+    dirty.resource_ = resource;
+    dirty.modified_.Reset();
+    dirty.retry_ = false;
+}
+
+bool ResourceSaver::IsDirty(Resource* resource) const
+{
+    return resource != nullptr && dirty_.Contains(resource->GetName());
+}
+
+void ResourceSaver::Flush(bool wait)
+{
+    // Files are written by one task at a time, resources still being written are saved once their tasks finish.
+    if (wait)
+        WaitForTasks();
+
+    for (auto it = dirty_.Begin(); it != dirty_.End();)
+    {
+        if (IsSaving(it->first_))
+            ++it;
+        else
+        {
+            Save(it->second_.resource_);
+            it = dirty_.Erase(it);
+        }
+    }
+
+    if (wait)
+        WaitForTasks();
+}
+
+void ResourceSaver::WaitForTasks()
+{
+    if (tasks_.Empty())
+        return;
+
+    // Only own writes are waited for, other work of the queue is not completed here. Writes that did not start yet are
+    // done immediately.
+    auto queue = GetSubsystem<WorkQueue>();
+    for (const auto& task : tasks_)
+    {
+        if (task->item_->completed_)
+            continue;
+        if (queue == nullptr || queue->RemoveWorkItem(task->item_))
+        {
+            WriteFile(task->item_, 0);
+            task->item_->completed_ = true;
+        }
+        else
+        {
+            while (!task->item_->completed_)
+                Time::Sleep(0);
+        }
+    }
+    FinishTasks();
+}
+
+void ResourceSaver::WriteFile(const WorkItem* item, unsigned threadIndex)
+{
+    auto task = static_cast<SaveTask*>(item->aux_);
+
+    String tempFileName = task->fileName_ + ".tmp";
+    {
+        File file(task->context_);
+        if (file.Open(tempFileName, FILE_WRITE))
+            task->success_ = file.Write(task->data_.GetData(), task->data_.GetSize()) == task->data_.GetSize();
+    }
+    if (task->success_)
+        task->success_ = ReplaceFile(tempFileName, task->fileName_);
+    if (!task->success_)
+        RemoveFile(tempFileName);
+}
+
+bool ResourceSaver::Save(Resource* resource)
+{
+    auto cache = GetSubsystem<ResourceCache>();
+    const String& resourceName = resource->GetName();
+
+    SharedPtr<SaveTask> task(new SaveTask());
+    task->context_ = context_;
+    task->resource_ = resource;
+    task->resourceName_ = resourceName;
+    task->fileName_ = cache->GetResourceFileName(resourceName);
+    if (task->fileName_.Empty())
+    {
+        URHO3D_LOGERRORF("Resource %s can not be saved, it is not stored in a resource directory.",
+            resourceName.CString());
+        return false;
+    }
+    if (!resource->Save(task->data_))
+    {
+        URHO3D_LOGERRORF("Failed to serialize resource %s.", resourceName.CString());
+        return false;
+    }
+
+    task->item_ = new WorkItem();
+    task->item_->workFunction_ = WriteFile;
+    task->item_->aux_ = task.Get();
+    task->item_->priority_ = 0;
+    tasks_.Push(task);
+    if (auto queue = GetSubsystem<WorkQueue>())
+        queue->AddWorkItem(task->item_);
+    else
+    {
+        WriteFile(task->item_, 0);
+        task->item_->completed_ = true;
+    }
+    return true;
+}
+
+bool ResourceSaver::IsSaving(const String& resourceName) const
+{
+    for (const auto& task : tasks_)
+    {
+        if (task->resourceName_ == resourceName)
+            return true;
+    }
+    return false;
+}
+
+void ResourceSaver::FinishTasks()
+{
+    for (auto it = tasks_.Begin(); it != tasks_.End();)
+    {
+        SaveTask* task = *it;
+        if (!task->item_->completed_)
+        {
+            ++it;
+            continue;
+        }
+
+        if (task->success_)
+        {
+            // Resource already has the state that was written, reloading it would only waste time and drop changes
+            // made since. File changes are reported with a delay, therefore reload is suppressed in time even though
+            // file was written already.
+            if (!ignoredReloads_.Contains(task->resourceName_))
+            {
+                GetSubsystem<ResourceCache>()->IgnoreResourceReload(task->resourceName_);
+                ignoredReloads_.Insert(task->resourceName_);
+            }
+        }
+        else
+        {
+            URHO3D_LOGERRORF("Failed to save resource %s to %s, retrying later.", task->resourceName_.CString(),
+                task->fileName_.CString());
+            // Newer modification is saved anyway.
+            if (!dirty_.Contains(task->resourceName_))
+            {
+                DirtyResource& dirty = dirty_[task->resourceName_];
+                dirty.resource_ = task->resource_;
+                dirty.retry_ = true;
+            }
+        }
+        it = tasks_.Erase(it);
+    }
+}
+
+void ResourceSaver::OnBeginFrame()
+{
+    if (!tasks_.Empty())
+        FinishTasks();
+
+    for (auto it = dirty_.Begin(); it != dirty_.End();)
+    {
+        unsigned delay = it->second_.retry_ ? RESOURCE_SAVE_RETRY_INTERVAL : debounceTime_;
+        if (it->second_.modified_.GetMSec(false) < delay || IsSaving(it->first_))
+            ++it;
+        else
+        {
+            Save(it->second_.resource_);
+            it = dirty_.Erase(it);
+        }
+    }
+}
+
+}
@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+
+namespace Urho3D
+{
+
+class Resource;
+
+/// Saves modified resources to their files in background. Resources marked as modified are saved once they were not
+/// modified for a debounce interval, when application loses focus or when saver is flushed. Resource is serialized on
+/// the main thread, file is written on a worker thread to a temporary file which then replaces the original file.
+/// Automatic reloading of successfully saved resources is suppressed, saving of resources whose files could not be
+/// written is retried.
+class ResourceSaver : public Object
+{
+    URHO3D_OBJECT(ResourceSaver, Object);
+public:
+    /// Construct.
+    explicit ResourceSaver(Context* context);
+    /// Destruct. Saves all modified resources.
+    ~ResourceSaver() override;
+
+    /// Mark resource as modified. It will be saved after it was not modified for a debounce interval.
+    void MarkDirty(Resource* resource);
+    /// Save all modified resources now. When wait is set, function returns after files are written.
+    void Flush(bool wait = false);
+    /// Return true if resource is modified and not saved yet.
+    bool IsDirty(Resource* resource) const;
+    /// Set time in milliseconds resource must not be modified for before it is saved.
+    void SetDebounceTime(unsigned milliseconds) { debounceTime_ = milliseconds; }
+    /// Return time in milliseconds resource must not be modified for before it is saved.
+    unsigned GetDebounceTime() const { return debounceTime_; }
+
+protected:
+    /// Modified resource waiting to be saved.
+    struct DirtyResource
+    {
+        /// Modified resource.
+        SharedPtr<Resource> resource_;
+        /// Time since last modification or failed attempt to save.
+        Timer modified_;
+        /// Flag indicating that saving failed and is retried after a longer interval.
+        bool retry_ = false;
+    };
+
+    /// Serialized resource written to a file by a worker thread.
+    struct SaveTask : public RefCounted
+    {
+        /// Context used for opening the file.
+        Context* context_ = nullptr;
+        /// Saved resource. Accessed only on the main thread.
+        SharedPtr<Resource> resource_;
+        /// Name of the resource.
+        String resourceName_;
+        /// Absolute name of the file.
+        String fileName_;
+        /// Serialized resource.
+        VectorBuffer data_;
+        /// Flag indicating that file was written successfully.
+        bool success_ = false;
+        /// Work item writing the file.
+        SharedPtr<WorkItem> item_;
+    };
+
+    /// Write file. Executed on worker thread.
+    static void WriteFile(const WorkItem* item, unsigned threadIndex);
+    /// Serialize resource and queue writing it's file. Return false if resource could not be serialized.
+    bool Save(Resource* resource);
+    /// Block until all files being written are written.
+    void WaitForTasks();
+    /// Return true if file of a resource is being written.
+    bool IsSaving(const String& resourceName) const;
+    /// Remove finished tasks and report failures.
+    void FinishTasks();
+    /// Save resources that were not modified for a debounce interval.
+    void OnBeginFrame();
+
+    /// Modified resources keyed by resource name.
+    HashMap<String, DirtyResource> dirty_;
+    /// Files being written.
+    Vector<SharedPtr<SaveTask>> tasks_;
+    /// Names of saved resources whose next reload was suppressed and file change was not reported yet.
+    HashSet<String> ignoredReloads_;
+    /// Time in milliseconds resource must not be modified for before it is saved.
+    unsigned debounceTime_ = 500;
+};
+
+}
@@ -0,0 +1,440 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "ResourceSearchIndex.h"
+
+
+namespace Urho3D
+{
+
+/// Number of entries matched between checks of time budget.
+static const unsigned SEARCH_TIME_CHECK_INTERVAL = 256;
+
+/// Return bit mask of characters present in a lowercase string.
+static unsigned long long GetCharMask(const String& text)
+{
+    unsigned long long mask = 0;
+    for (unsigned i = 0; i < text.Length(); i++)
+        mask |= 1ULL << ((unsigned char)text[i] & 63u);
+    return mask;
+}
+
+/// Return true if all characters of query appear in text in the same order.
+static bool IsSubsequence(const String& query, const String& text)
+{
+    unsigned pos = 0;
+    for (unsigned i = 0; i < text.Length() && pos < query.Length(); i++)
+    {
+        if (text[i] == query[pos])
+            pos++;
+    }
+    return pos == query.Length();
+}
+
+/// Return true if entry a is ordered before entry b.
+static bool CompareEntries(const ResourceSearchEntry& a, const ResourceSearchEntry& b)
+{
+    int order = a.key_.Compare(b.key_);
+    return order < 0 || (order == 0 && a.resourceName_ < b.resourceName_);
+}
+
+/// Return index of first entry whose key is not less than specified key.
+static unsigned LowerBound(const Vector<ResourceSearchEntry>& entries, const String& key)
+{
+    unsigned first = 0;
+    unsigned count = entries.Size();
+    while (count > 0)
+    {
+        unsigned step = count / 2;
+        if (entries[first + step].key_ < key)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    return first;
+}
+
+/// Initialize entry of a file.
+static ResourceSearchEntry MakeEntry(const String& resourceName)
+{
+    ResourceSearchEntry entry;
+    entry.resourceName_ = resourceName;
+    entry.key_ = GetFileNameAndExtension(resourceName).ToLower();
+    entry.charMask_ = GetCharMask(entry.key_);
+    return entry;
+}
+
+ResourceSearchIndex::ResourceSearchIndex(Context* context)
+    : Object(context)
+{
+    SubscribeToEvent(E_BEGINFRAME, [&](StringHash, VariantMap&) { OnBeginFrame(); });
+    SubscribeToEvent(E_FILECHANGED, [&](StringHash, VariantMap& args) {
+        OnFileChanged(args[FileChanged::P_RESOURCENAME].GetString());
+    });
+    Rebuild();
+}
+
+ResourceSearchIndex::~ResourceSearchIndex()
+{
+    // Worker threads must not write to destroyed tasks.
+    WaitForScan();
+}
+
+void ResourceSearchIndex::Rebuild()
+{
+    WaitForScan();
+
+    auto fs = GetSubsystem<FileSystem>();
+    auto queue = GetSubsystem<WorkQueue>();
+
+    resourceDirs_ = GetSubsystem<ResourceCache>()->GetResourceDirs();
+    entries_.Clear();
+    pendingChanges_.Clear();
+    numUnresolved_ = 0;
+    resolveCursor_ = 0;
+    revision_++;
+
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        SharedPtr<ScanTask> task(new ScanTask());
+        task->fileSystem_ = fs;
+        task->resourceDir_ = resourceDir;
+        task->item_ = new WorkItem();
+        task->item_->workFunction_ = ScanResourceDir;
+        task->item_->aux_ = task.Get();
+        // Lowest priority, so that frame rendering never waits for the scan.
+        task->item_->priority_ = 0;
+        scanTasks_.Push(task);
+        queue->AddWorkItem(task->item_);
+    }
+}
+
+void ResourceSearchIndex::WaitForScan()
+{
+    if (scanTasks_.Empty())
+        return;
+
+    // Scans that did not start yet are cancelled and only running scans are waited for, other work of the queue is not
+    // completed here.
+    if (auto queue = GetSubsystem<WorkQueue>())
+    {
+        for (const auto& task : scanTasks_)
+        {
+            if (!queue->RemoveWorkItem(task->item_))
+            {
+                while (!task->item_->completed_)
+                    Time::Sleep(0);
+            }
+        }
+    }
+    scanTasks_.Clear();
+}
+
+void ResourceSearchIndex::ScanResourceDir(const WorkItem* item, unsigned threadIndex)
+{
+    auto task = static_cast<ScanTask*>(item->aux_);
+
+    Vector<String> files;
+    task->fileSystem_->ScanDir(files, task->resourceDir_, "", SCAN_FILES, true);
+
+    task->entries_.Reserve(files.Size());
+    for (const auto& file : files)
+        task->entries_.Push(MakeEntry(file));
+    Sort(task->entries_.Begin(), task->entries_.End(), CompareEntries);
+}
+
+void ResourceSearchIndex::FinishScan()
+{
+    // Sorted entries of all resource directories are merged. When a file exists in multiple resource directories,
+    // only one entry is kept.
+    unsigned total = 0;
+    for (const auto& task : scanTasks_)
+        total += task->entries_.Size();
+
+    HashSet<String> names;
+    PODVector<unsigned> positions(scanTasks_.Size());
+    for (unsigned& position : positions)
+        position = 0;
+
+    entries_.Clear();
+    entries_.Reserve(total);
+    for (;;)
+    {
+        unsigned next = M_MAX_UNSIGNED;
+        for (unsigned i = 0; i < scanTasks_.Size(); i++)
+        {
+            const auto& taskEntries = scanTasks_[i]->entries_;
+            if (positions[i] < taskEntries.Size() && (next == M_MAX_UNSIGNED ||
+                CompareEntries(taskEntries[positions[i]], scanTasks_[next]->entries_[positions[next]])))
+                next = i;
+        }
+        if (next == M_MAX_UNSIGNED)
+            break;
+
+        const ResourceSearchEntry& entry = scanTasks_[next]->entries_[positions[next]++];
+        if (scanTasks_.Size() > 1)
+        {
+            if (names.Contains(entry.resourceName_))
+                continue;
+            names.Insert(entry.resourceName_);
+        }
+        entries_.Push(entry);
+    }
+
+    scanTasks_.Clear();
+    numUnresolved_ = entries_.Size();
+    resolveCursor_ = 0;
+    revision_++;
+
+    Vector<String> changes;
+    changes.Swap(pendingChanges_);
+    for (const auto& change : changes)
+        OnFileChanged(change);
+}
+
+void ResourceSearchIndex::OnFileChanged(const String& resourceName)
+{
+    if (!IsReady())
+    {
+        pendingChanges_.Push(resourceName);
+        return;
+    }
+
+    auto fs = GetSubsystem<FileSystem>();
+    String name = RemoveTrailingSlash(GetInternalPath(resourceName));
+
+    // Changed item may be a file or a directory. Directory is scanned, because watchers do not always report changes
+    // of directory contents individually.
+    bool exists = false;
+    Vector<String> files;
+    for (const auto& resourceDir : resourceDirs_)
+    {
+        if (fs->FileExists(resourceDir + name))
+        {
+            AddEntry(name);
+            exists = true;
+        }
+        else if (fs->DirExists(resourceDir + name))
+        {
+            files.Clear();
+            fs->ScanDir(files, resourceDir + name, "", SCAN_FILES, true);
+            for (const auto& file : files)
+                AddEntry(name + "/" + file);
+            exists = true;
+        }
+    }
+
+    if (!exists)
+    {
+        // File or directory was removed.
+        String dirPrefix = name + "/";
+        unsigned kept = 0;
+        for (unsigned i = 0; i < entries_.Size(); i++)
+        {
+            ResourceSearchEntry& entry = entries_[i];
+            if (entry.resourceName_ == name || entry.resourceName_.StartsWith(dirPrefix))
+            {
+                if (!entry.contentTypeResolved_)
+                    numUnresolved_--;
+                continue;
+            }
+            if (kept != i)
+                entries_[kept] = entry;
+            kept++;
+        }
+        entries_.Resize(kept);
+    }
+
+    resolveCursor_ = 0;
+    revision_++;
+}
+
+void ResourceSearchIndex::AddEntry(const String& resourceName)
+{
+    unsigned index = FindEntry(resourceName);
+    if (index != M_MAX_UNSIGNED)
+    {
+        // Modified file may have a different content type now.
+        if (entries_[index].contentTypeResolved_)
+        {
+            entries_[index].contentTypeResolved_ = false;
+            numUnresolved_++;
+        }
+        return;
+    }
+
+    ResourceSearchEntry entry = MakeEntry(resourceName);
+    index = LowerBound(entries_, entry.key_);
+    while (index < entries_.Size() && CompareEntries(entries_[index], entry))
+        index++;
+    entries_.Insert(index, entry);
+    numUnresolved_++;
+}
+
+unsigned ResourceSearchIndex::FindEntry(const String& resourceName) const
+{
+    String key = GetFileNameAndExtension(resourceName).ToLower();
+    for (unsigned i = LowerBound(entries_, key); i < entries_.Size() && entries_[i].key_ == key; i++)
+    {
+        if (entries_[i].resourceName_ == resourceName)
+            return i;
+    }
+    return M_MAX_UNSIGNED;
+}
+
+void ResourceSearchIndex::ResolveContentType(ResourceSearchEntry& entry)
+{
+    if (entry.contentTypeResolved_)
+        return;
+
+    entry.contentType_ = GetContentType(context_, entry.resourceName_);
+    entry.contentTypeResolved_ = true;
+    numUnresolved_--;
+}
+
+bool ResourceSearchIndex::Matches(ResourceSearchEntry& entry, const ResourceSearch& search,
+    unsigned long long queryMask)
+{
+    if ((entry.charMask_ & queryMask) != queryMask || !IsSubsequence(search.query_, entry.key_))
+        return false;
+
+    if (search.contentType_ != CTYPE_UNKNOWN)
+    {
+        ResolveContentType(entry);
+        return entry.contentType_ == search.contentType_;
+    }
+    return true;
+}
+
+void ResourceSearchIndex::BeginSearch(ResourceSearch& search, const String& query, ContentType contentType)
+{
+    String lowerQuery = query.ToLower();
+    unsigned long long queryMask = GetCharMask(lowerQuery);
+
+    // Query is being typed. Every result of a longer query is also a result of the shorter one, therefore results
+    // of the previous search only need to be filtered.
+    if (search.complete_ && search.revision_ == revision_ && search.contentType_ == contentType &&
+        !search.query_.Empty() && lowerQuery.StartsWith(search.query_))
+    {
+        search.query_ = lowerQuery;
+        PODVector<unsigned> prefixMatches;
+        PODVector<unsigned> fuzzyMatches;
+        for (unsigned index : search.results_)
+        {
+            ResourceSearchEntry& entry = entries_[index];
+            if (entry.key_.StartsWith(lowerQuery))
+                prefixMatches.Push(index);
+            else if (Matches(entry, search, queryMask))
+                fuzzyMatches.Push(index);
+        }
+        search.results_ = prefixMatches;
+        search.results_.Push(fuzzyMatches);
+        return;
+    }
+
+    search.query_ = lowerQuery;
+    search.contentType_ = contentType;
+    search.revision_ = revision_;
+    search.results_.Clear();
+    search.cursor_ = 0;
+    search.complete_ = search.query_.Empty();
+    if (search.complete_)
+        return;
+
+    // Entries are sorted by key, so files beginning with query are adjacent.
+    for (unsigned i = LowerBound(entries_, search.query_); i < entries_.Size() &&
+        entries_[i].key_.StartsWith(search.query_); i++)
+    {
+        if (search.contentType_ == CTYPE_UNKNOWN || Matches(entries_[i], search, queryMask))
+            search.results_.Push(i);
+    }
+}
+
+bool ResourceSearchIndex::UpdateSearch(ResourceSearch& search, unsigned maxMicroseconds)
+{
+    if (search.revision_ != revision_)
+    {
+        search.complete_ = false;
+        BeginSearch(search, search.query_, search.contentType_);
+    }
+
+    if (search.complete_)
+        return true;
+
+    unsigned long long queryMask = GetCharMask(search.query_);
+    HiresTimer timer;
+    while (search.cursor_ < entries_.Size())
+    {
+        ResourceSearchEntry& entry = entries_[search.cursor_];
+        // Prefix matches were found by BeginSearch() already.
+        if (!entry.key_.StartsWith(search.query_) && Matches(entry, search, queryMask))
+            search.results_.Push(search.cursor_);
+
+        if (++search.cursor_ % SEARCH_TIME_CHECK_INTERVAL == 0 && timer.GetUSec(false) >= maxMicroseconds)
+            return false;
+    }
+
+    // Index is complete only after resource directories are scanned.
+    search.complete_ = IsReady();
+    return search.complete_;
+}
+
+void ResourceSearchIndex::OnBeginFrame()
+{
+    if (GetSubsystem<ResourceCache>()->GetResourceDirs() != resourceDirs_)
+        Rebuild();
+
+    if (!scanTasks_.Empty())
+    {
+        for (const auto& task : scanTasks_)
+        {
+            if (!task->item_->completed_)
+                return;
+        }
+        FinishScan();
+    }
+
+    if (numUnresolved_ == 0)
+        return;
+
+    HiresTimer timer;
+    while (numUnresolved_ > 0 && timer.GetUSec(false) < contentTypeBudget_ * 1000LL)
+    {
+        if (resolveCursor_ >= entries_.Size())
+            resolveCursor_ = 0;
+        ResolveContentType(entries_[resolveCursor_++]);
+    }
+}
+
+}
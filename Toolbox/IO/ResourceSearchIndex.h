@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2008-2017 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include "IO/ContentUtilities.h"
+
+
+namespace Urho3D
+{
+
+class FileSystem;
+
+/// File known to the search index.
+struct ResourceSearchEntry
+{
+    /// Resource name relative to resource directories.
+    String resourceName_;
+    /// Lowercase file name entries are matched and sorted by.
+    String key_;
+    /// Bit mask of characters present in key. Entries missing any character of a query are rejected without
+    /// comparing strings.
+    unsigned long long charMask_ = 0;
+    /// Content type of the file. Valid only when contentTypeResolved_ is set.
+    ContentType contentType_ = CTYPE_UNKNOWN;
+    /// Flag indicating that content type was determined.
+    bool contentTypeResolved_ = false;
+};
+
+/// State of a search. Results are streamed, search is continued by calling ResourceSearchIndex::UpdateSearch()
+/// every frame until it completes.
+struct ResourceSearch
+{
+    /// Lowercase query.
+    String query_;
+    /// Content type results are restricted to. CTYPE_UNKNOWN matches any file.
+    ContentType contentType_ = CTYPE_UNKNOWN;
+    /// Indices of matching entries. Files whose name begins with query come first, followed by fuzzy matches.
+    PODVector<unsigned> results_;
+    /// Revision of index results refer to.
+    unsigned revision_ = 0;
+    /// Index of next entry to be matched.
+    unsigned cursor_ = 0;
+    /// Flag indicating that all entries were matched.
+    bool complete_ = true;
+};
+
+/// Index of all files in resource directories for searching by file name and content type. Resource directories are
+/// scanned in parallel on worker threads, afterwards index is updated incrementally as ResourceCache reports file
+/// changes. Prefix matches are found by binary search, fuzzy matches are found by a scan spread over multiple frames.
+class ResourceSearchIndex : public Object
+{
+    URHO3D_OBJECT(ResourceSearchIndex, Object);
+public:
+    /// Construct.
+    explicit ResourceSearchIndex(Context* context);
+    /// Destruct.
+    ~ResourceSearchIndex() override;
+
+    /// Rescan all resource directories.
+    void Rebuild();
+    /// Return true when resource directories are scanned.
+    bool IsReady() const { return scanTasks_.Empty(); }
+    /// Return indexed files sorted by key.
+    const Vector<ResourceSearchEntry>& GetEntries() const { return entries_; }
+    /// Return revision of index. Revision changes whenever entries are added or removed.
+    unsigned GetRevision() const { return revision_; }
+
+    /// Start a new search. Prefix matches are available immediately.
+    void BeginSearch(ResourceSearch& search, const String& query, ContentType contentType = CTYPE_UNKNOWN);
+    /// Continue search for at most specified amount of microseconds. Search is restarted if index changed since it
+    /// began. Return true when search is complete.
+    bool UpdateSearch(ResourceSearch& search, unsigned maxMicroseconds);
+
+    /// Set time in milliseconds spent every frame on determining content types of indexed files.
+    void SetContentTypeBudget(unsigned milliseconds) { contentTypeBudget_ = milliseconds; }
+    /// Return time in milliseconds spent every frame on determining content types of indexed files.
+    unsigned GetContentTypeBudget() const { return contentTypeBudget_; }
+
+protected:
+    /// Files of one resource directory scanned by a worker thread.
+    struct ScanTask : public RefCounted
+    {
+        /// File system used for scanning.
+        FileSystem* fileSystem_ = nullptr;
+        /// Resource directory.
+        String resourceDir_;
+        /// Entries sorted by key.
+        Vector<ResourceSearchEntry> entries_;
+        /// Work item scanning the directory.
+        SharedPtr<WorkItem> item_;
+    };
+
+    /// Scan resource directory. Executed on worker thread.
+    static void ScanResourceDir(const WorkItem* item, unsigned threadIndex);
+    /// Cancel scans that did not start yet and block until running scans are finished.
+    void WaitForScan();
+    /// Merge entries of finished scans into index.
+    void FinishScan();
+    /// Add, update or remove entries of a changed file or directory.
+    void OnFileChanged(const String& resourceName);
+    /// Add entry unless it is indexed already.
+    void AddEntry(const String& resourceName);
+    /// Return index of entry or M_MAX_UNSIGNED if file is not indexed.
+    unsigned FindEntry(const String& resourceName) const;
+    /// Determine content type of entry if it was not determined yet.
+    void ResolveContentType(ResourceSearchEntry& entry);
+    /// Return true if entry matches search.
+    bool Matches(ResourceSearchEntry& entry, const ResourceSearch& search, unsigned long long queryMask);
+    /// Merge finished scans, apply queued changes and determine content types of new files.
+    void OnBeginFrame();
+
+    /// Resource directories index was built from.
+    Vector<String> resourceDirs_;
+    /// Indexed files sorted by key.
+    Vector<ResourceSearchEntry> entries_;
+    /// Scans in progress.
+    Vector<SharedPtr<ScanTask>> scanTasks_;
+    /// Changes reported while resource directories are being scanned.
+    Vector<String> pendingChanges_;
+    /// Revision of index.
+    unsigned revision_ = 0;
+    /// Number of entries whose content type is not determined yet.
+    unsigned numUnresolved_ = 0;
+    /// Index of entry content type resolving continues from.
+    unsigned resolveCursor_ = 0;
+    /// Time in milliseconds spent every frame on determining content types.
+    unsigned contentTypeBudget_ = 1;
+};
+
+}
@@ -35,6 +35,8 @@
 #include <Urho3D/Graphics/Model.h>
 #include <Urho3D/Graphics/Renderer.h>
 #include <Urho3D/Graphics/RenderPath.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Graphics/Viewport.h>
 #include "AttributeInspector.h"
 #include "ImGuiDock.h"
 #include "Widgets.h"
@@ -44,7 +46,8 @@
 #include <Urho3D/Graphics/StaticModel.h>
 #include <Urho3D/Graphics/Octree.h>
 #include <Urho3D/Graphics/Graphics.h>
-#include <Graphics/SceneView.h>
+#include <Graphics/PreviewRenderer.h>
+#include <IO/ResourceSaver.h>
 
 
 namespace Urho3D
@@ -69,40 +72,61 @@ static const char* fillModeNames[] =
 
 const float attributeIndentLevel = 15.f;
 
-/// Renders material preview in attribute inspector.
-class MaterialView : public SceneView
+/// Return signature of render path state which affects how previews look.
+static unsigned GetRenderPathSignature(RenderPath* path)
+{
+    unsigned signature = path->commands_.Size();
+    for (const auto& command : path->commands_)
+        signature = signature * 31 + (command.enabled_ ? 1 : 0);
+    return signature;
+}
+
+/// Renders material preview in attribute inspector. Preview is rendered by PreviewRenderer only when material, render
+/// path or camera changes.
+class MaterialView
 {
 public:
     explicit MaterialView(Context* context, Material* material, Viewport* effectSource)
-        : SceneView(context, {0, 0, 200, 200})
-        , material_(material)
+        : material_(material)
+        , effectSource_(effectSource)
     {
-        // Workaround: for some reason this overriden method of our class does not get called by SceneView constructor.
-        CreateObjects();
-
-        // Scene viewport renderpath must be same as material viewport renderpath
-        auto path = effectSource->GetRenderPath();
-        viewport_->SetRenderPath(path);
-        auto light = camera_->GetComponent<Light>();
-        for (auto& command: path->commands_)
-        {
-            if (command.pixelShaderName_ == "PBRDeferred")
-            {
-                // Lights in PBR scenes need modifications, otherwise obects in material preview look very dark
-                light->SetUsePhysicalValues(true);
-                light->SetBrightness(5000);
-                light->SetShadowCascade(CascadeParameters(10, 20, 30, 40, 10));
-                break;
-            }
-        }
+        renderer_ = PreviewRenderer::GetOrCreate(context);
     }
 
+    ~MaterialView()
+    {
+        if (renderer_)
+            renderer_->ReleaseTarget(texture_);
+    }
+
+    /// Request rendering of preview.
+    void Invalidate() { dirty_ = true; }
+
     void Render()
     {
         int size = static_cast<int>(ui::GetWindowWidth() - ui::GetCursorPosX());
-        SetSize({0, 0, size, size});
-        ui::Image(texture_.Get(), ToImGui(rect_.Size()));
-        Input* input = camera_->GetSubsystem<Input>();
+        if (texture_.Null() || size != size_)
+            Resize(size);
+
+        if (effectSource_)
+        {
+            RenderPath* path = effectSource_->GetRenderPath();
+            unsigned signature = GetRenderPathSignature(path);
+            if (path != renderPath_ || signature != renderPathSignature_)
+            {
+                renderPath_ = path;
+                renderPathSignature_ = signature;
+                dirty_ = true;
+            }
+        }
+        if (renderer_ && renderer_->GetResourceRevision() != resourceRevision_)
+        {
+            resourceRevision_ = renderer_->GetResourceRevision();
+            dirty_ = true;
+        }
+
+        ui::Image(texture_.Get(), ImVec2(size_, size_));
+        Input* input = material_->GetSubsystem<Input>();
         bool rightMouseButtonDown = input->GetMouseButtonDown(MOUSEB_RIGHT);
         if (ui::IsItemHovered())
         {
@@ -118,38 +142,44 @@ public:
             {
                 if (input->GetKeyPress(KEY_ESCAPE))
                 {
-                    camera_->SetPosition(Vector3::BACK * distance_);
-                    camera_->LookAt(Vector3::ZERO);
+                    cameraRotation_ = Quaternion::IDENTITY;
+                    dirty_ = true;
                 }
                 else
                 {
                     IntVector2 delta = input->GetMouseMove();
-                    camera_->RotateAround(Vector3::ZERO,
-                                          Quaternion(delta.x_ * 0.1f, camera_->GetUp()) *
-                                          Quaternion(delta.y_ * 0.1f, camera_->GetRight()), TS_WORLD);
+                    if (delta != IntVector2::ZERO)
+                    {
+                        // Camera orbits around the figure.
+                        cameraRotation_ = Quaternion(delta.x_ * 0.1f, cameraRotation_ * Vector3::UP) *
+                            Quaternion(delta.y_ * 0.1f, cameraRotation_ * Vector3::RIGHT) * cameraRotation_;
+                        dirty_ = true;
+                    }
                 }
             }
             else
                 SetGrab(false);
         }
+
+        if (dirty_ && renderer_)
+        {
+            auto model = material_->GetSubsystem<ResourceCache>()->GetResource<Model>(
+                ToString("Models/%s.mdl", figures_[figureIndex_]));
+            // Box is rather big after autodetecting scale, but other figures are ok. And teapot is rather small.
+            float scale = 1.0f;
+            if (String(figures_[figureIndex_]) == "Box")
+                scale = 0.7f;
+            else if (String(figures_[figureIndex_]) == "TeaPot")
+                scale = 1.2f;
+            if (renderer_->RenderPreview(texture_, model, material_, scale, cameraRotation_, distance_, renderPath_))
+                dirty_ = false;
+        }
     }
 
     void ToggleModel()
     {
-        auto model = node_->GetOrCreateComponent<StaticModel>();
-
-        model->SetModel(node_->GetSubsystem<ResourceCache>()->GetResource<Model>(ToString("Models/%s.mdl", figures_[figureIndex_])));
-        model->SetMaterial(material_);
-        auto bb = model->GetBoundingBox();
-        auto scale = 1.f / Max(bb.Size().x_, Max(bb.Size().y_, bb.Size().z_));
-        if (figures_[figureIndex_] == "Box")    // Box is rather big after autodetecting scale, but other figures
-            scale *= 0.7f;                      // are ok. Patch the box then.
-        else if (figures_[figureIndex_] == "TeaPot")    // And teapot is rather small.
-            scale *= 1.2f;
-        node_->SetScale(scale);
-        node_->SetWorldPosition(node_->GetWorldPosition() - model->GetWorldBoundingBox().Center());
-
-        figureIndex_ = ++figureIndex_ % figures_.Size();
+        figureIndex_ = (figureIndex_ + 1) % figures_.Size();
+        dirty_ = true;
     }
 
     void SetGrab(bool enable)
@@ -158,7 +188,7 @@ public:
             return;
 
         mouseGrabbed_ = enable;
-        Input* input = camera_->GetSubsystem<Input>();
+        Input* input = material_->GetSubsystem<Input>();
         if (enable && input->IsMouseVisible())
             input->SetMouseVisible(false);
         else if (!enable && !input->IsMouseVisible())
@@ -166,30 +196,131 @@ public:
     }
 
 protected:
-    void CreateObjects() override
+    /// Take render target from pool if displayed size no longer fits current one.
+    void Resize(int size)
     {
-        SceneView::CreateObjects();
-        node_ = scene_->CreateChild("Sphere");
-        ToggleModel();
-        camera_->CreateComponent<Light>();
-        camera_->SetPosition(Vector3::BACK * distance_);
-        camera_->LookAt(Vector3::ZERO);
+        size_ = size;
+        if (renderer_.Null())
+            return;
+
+        if (texture_ && texture_->GetWidth() == PreviewRenderer::GetTargetSize(size))
+            return;
+
+        renderer_->ReleaseTarget(texture_);
+        texture_ = renderer_->AcquireTarget(size);
+        dirty_ = true;
     }
 
+    /// Renderer shared by all previews.
+    WeakPtr<PreviewRenderer> renderer_;
     /// Material which is being previewed.
     SharedPtr<Material> material_;
-    /// Node holding figure to which material is applied.
-    WeakPtr<Node> node_;
+    /// Viewport whose render path is used for rendering preview.
+    WeakPtr<Viewport> effectSource_;
+    /// Render path preview was rendered with.
+    WeakPtr<RenderPath> renderPath_;
+    /// Signature of render path state preview was rendered with.
+    unsigned renderPathSignature_ = 0;
+    /// Revision of resources preview was rendered with.
+    unsigned resourceRevision_ = 0;
+    /// Pooled render target preview is rendered to.
+    SharedPtr<Texture2D> texture_;
+    /// Width and height of displayed preview.
+    int size_ = 0;
+    /// Flag indicating that preview must be rendered again.
+    bool dirty_ = true;
     /// Flag indicating if this widget grabbed mouse for rotating material node.
     bool mouseGrabbed_ = false;
+    /// Orientation of camera orbiting the figure.
+    Quaternion cameraRotation_ = Quaternion::IDENTITY;
     /// Index of current figure displaying material.
-    int figureIndex_ = 0;
+    unsigned figureIndex_ = 0;
     /// A list of figures between which material view can be toggled.
     PODVector<const char*> figures_{"Sphere", "Box", "Torus", "TeaPot"};
     /// Distance from camera to figure.
     float distance_ = 1.5f;
 };
 
+/// Maximum number of attribute values read per frame when looking for attributes whose values differ among items.
+static const unsigned MIXED_VALUES_SCAN_BUDGET = 4096;
+/// Color of label of attribute whose values differ among items.
+static const Color MIXED_VALUE_COLOR(1.0f, 0.75f, 0.25f);
+/// Difference of euler angles in degrees below which a rotation component is considered unchanged.
+static const float EULER_ANGLE_EPSILON = 0.0005f;
+
+/// Copy components whose values differ between old and new value into target value.
+template <class T, class C>
+static T CopyChangedComponents(const T& oldValue, const T& newValue, T target, C epsilon = C())
+{
+    const unsigned numComponents = sizeof(T) / sizeof(C);
+    auto oldData = reinterpret_cast<const C*>(&oldValue);
+    auto newData = reinterpret_cast<const C*>(&newValue);
+    auto targetData = reinterpret_cast<C*>(&target);
+    for (unsigned i = 0; i < numComponents; i++)
+    {
+        if (Abs(newData[i] - oldData[i]) > epsilon)
+            targetData[i] = newData[i];
+    }
+    return target;
+}
+
+/// Apply modification of attribute value done by a widget to value of another item. Only components changed by the
+/// widget are modified, for other types new value replaces item value.
+static void ApplyModification(const Variant& oldValue, const Variant& newValue, Variant& itemValue)
+{
+    if (itemValue.GetType() != newValue.GetType() || oldValue.GetType() != newValue.GetType())
+    {
+        itemValue = newValue;
+        return;
+    }
+
+    switch (newValue.GetType())
+    {
+    case VAR_VECTOR2:
+        itemValue = CopyChangedComponents<Vector2, float>(oldValue.GetVector2(), newValue.GetVector2(),
+            itemValue.GetVector2());
+        break;
+    case VAR_VECTOR3:
+        itemValue = CopyChangedComponents<Vector3, float>(oldValue.GetVector3(), newValue.GetVector3(),
+            itemValue.GetVector3());
+        break;
+    case VAR_VECTOR4:
+        itemValue = CopyChangedComponents<Vector4, float>(oldValue.GetVector4(), newValue.GetVector4(),
+            itemValue.GetVector4());
+        break;
+    case VAR_QUATERNION:
+    {
+        // Rotation is edited as euler angles.
+        Vector3 angles = CopyChangedComponents<Vector3, float>(oldValue.GetQuaternion().EulerAngles(),
+            newValue.GetQuaternion().EulerAngles(), itemValue.GetQuaternion().EulerAngles(), EULER_ANGLE_EPSILON);
+        itemValue = Quaternion(angles.x_, angles.y_, angles.z_);
+        break;
+    }
+    case VAR_COLOR:
+        itemValue = CopyChangedComponents<Color, float>(oldValue.GetColor(), newValue.GetColor(),
+            itemValue.GetColor());
+        break;
+    case VAR_INTVECTOR2:
+        itemValue = CopyChangedComponents<IntVector2, int>(oldValue.GetIntVector2(), newValue.GetIntVector2(),
+            itemValue.GetIntVector2());
+        break;
+    case VAR_INTVECTOR3:
+        itemValue = CopyChangedComponents<IntVector3, int>(oldValue.GetIntVector3(), newValue.GetIntVector3(),
+            itemValue.GetIntVector3());
+        break;
+    case VAR_INTRECT:
+        itemValue = CopyChangedComponents<IntRect, int>(oldValue.GetIntRect(), newValue.GetIntRect(),
+            itemValue.GetIntRect());
+        break;
+    case VAR_RECT:
+        itemValue = CopyChangedComponents<Rect, float>(oldValue.GetRect(), newValue.GetRect(), itemValue.GetRect());
+        break;
+    default:
+        itemValue = newValue;
+        break;
+    }
+}
+
 struct AttributeInspectorBuffer
 {
     explicit AttributeInspectorBuffer(const String& defaultValue=String::EMPTY)
@@ -208,14 +339,100 @@ AttributeInspector::AttributeInspector(Urho3D::Context* context)
 }
 
 void AttributeInspector::RenderAttributes(const PODVector<Serializable*>& items)
+{
+    // Every item is a group of it's own. Groups are rebuilt only when items change.
+    bool changed = groups_.Size() != items.Size();
+    for (unsigned i = 0; !changed && i < items.Size(); i++)
+        changed = groups_[i].Size() != 1 || groups_[i].Front() != items[i];
+
+    if (changed)
+    {
+        groups_.Clear();
+        groups_.Resize(items.Size());
+        for (unsigned i = 0; i < items.Size(); i++)
+            groups_[i].Push(items[i]);
+        OnItemsChanged();
+    }
+
+    RenderGroups();
+}
+
+void AttributeInspector::RenderAttributes(const Vector<PODVector<Serializable*>>& groups)
+{
+    if (groups_ != groups)
+    {
+        groups_ = groups;
+        OnItemsChanged();
+    }
+
+    RenderGroups();
+}
+
+void AttributeInspector::OnItemsChanged()
 {
     /// If serializable changes clear value buffers so values from previous item do not appear when inspecting new item.
-    if (lastSerializables_ != items)
+    maxWidth_ = 0;
+    customizations_.Clear();
+    mixedValues_.Clear();
+}
+
+void AttributeInspector::UpdateMixedValues(const PODVector<Serializable*>& group, MixedValues& mixedValues,
+    unsigned& budget)
+{
+    const auto& attributes = *group.Front()->GetAttributes();
+    unsigned numAttributes = attributes.Size();
+    if (mixedValues.mixed_.Size() != numAttributes)
     {
-        maxWidth_ = 0;
-        lastSerializables_ = items;
+        mixedValues.mixed_.Resize(numAttributes);
+        mixedValues.scanMixed_.Resize(numAttributes);
+        mixedValues.reference_.Resize(numAttributes);
+        for (unsigned i = 0; i < numAttributes; i++)
+            mixedValues.mixed_[i] = false;
+        mixedValues.cursor_ = 0;
     }
 
+    // Values of items are compared against first item, a limited number of attributes per frame. Result of a complete
+    // scan is published when it ends, then next scan starts. At least one item is compared on every frame.
+    for (bool first = true;; first = false)
+    {
+        if (mixedValues.cursor_ == 0)
+        {
+            for (unsigned i = 0; i < numAttributes; i++)
+            {
+                mixedValues.scanMixed_[i] = false;
+                if (!(attributes[i].mode_ & AM_NOEDIT))
+                    group.Front()->OnGetAttribute(attributes[i], mixedValues.reference_[i]);
+            }
+            mixedValues.cursor_ = 1;
+        }
+
+        if (mixedValues.cursor_ >= group.Size())
+        {
+            mixedValues.mixed_ = mixedValues.scanMixed_;
+            mixedValues.cursor_ = 0;
+            break;
+        }
+
+        if (budget == 0 && !first)
+            break;
+        budget -= Min(budget, numAttributes);
+
+        Serializable* item = group[mixedValues.cursor_++];
+        for (unsigned i = 0; i < numAttributes; i++)
+        {
+            if (mixedValues.scanMixed_[i] || (attributes[i].mode_ & AM_NOEDIT))
+                continue;
+            item->OnGetAttribute(attributes[i], mixedValues.value_);
+            if (mixedValues.value_ != mixedValues.reference_[i])
+                mixedValues.scanMixed_[i] = true;
+        }
+    }
+}
+
+void AttributeInspector::RenderGroups()
+{
+    unsigned scanBudget = MIXED_VALUES_SCAN_BUDGET;
+
     ui::TextUnformatted("Filter");
     NextColumn();
     ui::PushID("FilterEdit");
@@ -226,52 +443,91 @@ void AttributeInspector::RenderAttributes(const PODVector<Serializable*>& items)
     ui::PopItemWidth();
     ui::PopID();
 
-    for (Serializable* item: items)
+    // Filter decides which attributes are hidden before they are customized.
+    if (lastFilter_ != &filter_.front())
+    {
+        lastFilter_ = &filter_.front();
+        customizations_.Clear();
+    }
+
+    for (const PODVector<Serializable*>& group : groups_)
     {
+        Serializable* item = group.Empty() ? nullptr : group.Front();
         if (item == nullptr)
             continue;
 
-        if (ui::CollapsingHeader(item->GetTypeName().CString(), ImGuiTreeNodeFlags_DefaultOpen))
+        // Title of a group does not affect it's id, so that header remains open when number of items changes.
+        String title = item->GetTypeName();
+        if (group.Size() > 1)
+            title = ToString("%s (%u)###%s", title.CString(), group.Size(), title.CString());
+
+        if (ui::CollapsingHeader(title.CString(), ImGuiTreeNodeFlags_DefaultOpen))
         {
             ui::PushID(item);
             const char* modifiedThisFrame = nullptr;
             const auto& attributes = *item->GetAttributes();
 
-            for (const AttributeInfo& info: attributes)
+            // Object at the same address may be of a different type if inspected object was deleted.
+            ItemCustomization& itemCustomization = customizations_[item];
+            if (itemCustomization.type_ != item->GetType() ||
+                itemCustomization.attributes_.Size() != attributes.Size())
             {
-                bool hidden = false;
-                Color color = Color::WHITE;
-                String tooltip;
+                itemCustomization.type_ = item->GetType();
+                itemCustomization.attributes_.Clear();
+                itemCustomization.attributes_.Resize(attributes.Size());
+            }
 
-                Variant value, oldValue;
-                value = oldValue = item->GetAttribute(info.name_);
+            // Attributes of multiple items are rendered as values of first item, the ones that differ are marked.
+            MixedValues* mixedValues = nullptr;
+            if (group.Size() > 1)
+            {
+                mixedValues = &mixedValues_[item];
+                UpdateMixedValues(group, *mixedValues, scanBudget);
+            }
 
-                if (value == info.defaultValue_)
-                    color = Color::GRAY;
+            for (unsigned attributeIndex = 0; attributeIndex < attributes.Size(); attributeIndex++)
+            {
+                const AttributeInfo& info = attributes[attributeIndex];
 
-                if (info.mode_ & AM_NOEDIT)
-                    hidden = true;
-                else if (filter_.front() && !info.name_.Contains(&filter_.front(), false))
-                    hidden = true;
+                Variant value, oldValue;
+                value = oldValue = item->GetAttribute(attributeIndex);
 
-                // Customize attribute rendering
+                // Customize attribute rendering. Listeners are asked only when value changes or customization was
+                // invalidated.
+                AttributeCustomization& customization = itemCustomization.attributes_[attributeIndex];
+                if (!customization.valid_ || customization.value_ != value)
                 {
+                    bool hidden = false;
+                    Color color = Color::WHITE;
+
+                    if (value == info.defaultValue_)
+                        color = Color::GRAY;
+
+                    if (info.mode_ & AM_NOEDIT)
+                        hidden = true;
+                    else if (filter_.front() && !info.name_.Contains(&filter_.front(), false))
+                        hidden = true;
+
                     using namespace AttributeInspectorAttribute;
                     VariantMap args;
                     args[P_SERIALIZABLE] = item;
                     args[P_ATTRIBUTEINFO] = (void*)&info;
                     args[P_COLOR] = color;
                     args[P_HIDDEN] = hidden;
-                    args[P_TOOLTIP] = tooltip;
+                    args[P_TOOLTIP] = String::EMPTY;
                     SendEvent(E_ATTRIBUTEINSPECTOATTRIBUTE, args);
-                    hidden = args[P_HIDDEN].GetBool();
-                    color = args[P_COLOR].GetColor();
-                    tooltip = args[P_TOOLTIP].GetString();
+                    customization.hidden_ = args[P_HIDDEN].GetBool();
+                    customization.color_ = args[P_COLOR].GetColor();
+                    customization.tooltip_ = args[P_TOOLTIP].GetString();
+                    customization.value_ = value;
+                    customization.valid_ = true;
                 }
 
-                if (hidden)
+                if (customization.hidden_)
                     continue;
 
+                bool mixed = mixedValues != nullptr && mixedValues->mixed_[attributeIndex];
+
                 ui::PushID(info.name_.CString());
 
                 bool expanded = true;
@@ -287,10 +543,15 @@ void AttributeInspector::RenderAttributes(const PODVector<Serializable*>& items)
                         expandable = true;
                 }
 
-                expanded = RenderAttributeLabel(info, color, expandable);
+                expanded = RenderAttributeLabel(info, mixed ? MIXED_VALUE_COLOR : customization.color_, expandable);
 
-                if (!tooltip.Empty() && ui::IsItemHovered())
-                    ui::SetTooltip("%s", tooltip.CString());
+                if (ui::IsItemHovered())
+                {
+                    if (mixed)
+                        ui::SetTooltip("Selected objects have different values.");
+                    else if (!customization.tooltip_.Empty())
+                        ui::SetTooltip("%s", customization.tooltip_.CString());
+                }
 
                 if (ui::IsItemHovered() && ui::IsMouseClicked(2))
                     ui::OpenPopup("Attribute Menu");
@@ -361,21 +622,49 @@ void AttributeInspector::RenderAttributes(const PODVector<Serializable*>& items)
                     assert(modifiedThisFrame == nullptr);
                     modifiedLastFrame_ = info.name_.CString();
 
-                    // Just started changing value of the attribute. Save old value required for event on modification end.
+                    // Just started changing value of the attribute. Save old values required for event on modification end.
                     if (!modifiedLastFrame)
-                        originalValue_ = oldValue;
+                    {
+                        originalValues_.Resize(group.Size());
+                        originalValues_[0] = oldValue;
+                        for (unsigned i = 1; i < group.Size(); i++)
+                            group[i]->OnGetAttribute(info, originalValues_[i]);
+                    }
 
-                    // Update attribute value and do nothing else for now.
-                    item->SetAttribute(info.name_, value);
+                    // Update attribute value of all items and do nothing else for now. Other items receive only
+                    // components modified by the widget, so their own values are preserved.
+                    item->SetAttribute(attributeIndex, value);
                     item->ApplyAttributes();
+                    for (unsigned i = 1; i < group.Size(); i++)
+                    {
+                        group[i]->OnGetAttribute(info, itemValue_);
+                        ApplyModification(oldValue, value, itemValue_);
+                        group[i]->SetAttribute(attributeIndex, itemValue_);
+                        group[i]->ApplyAttributes();
+                    }
+
+                    // Modified components may have made values same, next scan verifies it.
+                    if (mixedValues != nullptr)
+                        mixedValues->cursor_ = 0;
                 }
                 else if (modifiedLastFrame && !ui::IsAnyItemActive())
                 {
                     // This attribute was modified on last frame, but not on this frame. Continuous attribute value modification
-                    // has ended and we can fire attribute modification event.
+                    // has ended and we can fire attribute modification event. Modification of multiple items is a
+                    // single batch.
+                    if (group.Size() > 1)
+                        SendEvent(E_ATTRIBUTEINSPECTBATCHBEGIN);
+
                     using namespace AttributeInspectorValueModified;
-                    SendEvent(E_ATTRIBUTEINSPECTVALUEMODIFIED, P_SERIALIZABLE, item, P_ATTRIBUTEINFO, (void*)&info,
-                        P_OLDVALUE, originalValue_, P_NEWVALUE, value);
+                    for (unsigned i = 0; i < group.Size() && i < originalValues_.Size(); i++)
+                    {
+                        group[i]->OnGetAttribute(info, itemValue_);
+                        SendEvent(E_ATTRIBUTEINSPECTVALUEMODIFIED, P_SERIALIZABLE, group[i], P_ATTRIBUTEINFO,
+                            (void*)&info, P_OLDVALUE, originalValues_[i], P_NEWVALUE, itemValue_);
+                    }
+
+                    if (group.Size() > 1)
+                        SendEvent(E_ATTRIBUTEINSPECTBATCHEND);
                 }
             }
 
@@ -388,6 +677,15 @@ void AttributeInspector::RenderAttributes(const PODVector<Serializable*>& items)
         modifiedLastFrame_ = nullptr;
 }
 
+void AttributeInspector::InvalidateCustomization()
+{
+    for (auto& item : customizations_)
+    {
+        for (AttributeCustomization& customization : item.second_.attributes_)
+            customization.valid_ = false;
+    }
+}
+
 void AttributeInspector::RenderAttributes(Serializable* item)
 {
     PODVector<Serializable*> items;
@@ -786,6 +1084,11 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
             return false;
 
         MaterialView* state = ui::GetUIState<MaterialView>(context_, material, effectSource_);
+        // Preview is rendered again only when material changes.
+        auto onMaterialModified = [&]() {
+            state->Invalidate();
+            SaveResource(material);
+        };
         ui::Indent(attributeIndentLevel);
 
         state->Render();
@@ -803,7 +1106,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::Combo("###cull", &valueInt, cullModeNames, (int)MAX_CULLMODES))
         {
             material->SetCullMode(static_cast<CullMode>(valueInt));
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Shadow Cull");
@@ -812,7 +1115,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::Combo("###shadowCull", &valueInt, cullModeNames, (int)MAX_CULLMODES))
         {
             material->SetShadowCullMode(static_cast<CullMode>(valueInt));
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Fill");
@@ -821,7 +1124,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::Combo("###fill", &valueInt, fillModeNames, (int)MAX_FILLMODES))
         {
             material->SetFillMode(static_cast<FillMode>(valueInt));
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         auto bias = material->GetDepthBias();
@@ -830,7 +1133,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::DragFloat("###constantBias_", &bias.constantBias_, 0.1f, -1, 1))
         {
             material->SetDepthBias(bias);
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Slope Scaled Bias");
@@ -838,7 +1141,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::DragFloat("###slopeScaledBias_", &bias.slopeScaledBias_, 1, -16, 16))
         {
             material->SetDepthBias(bias);
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Normal Offset");
@@ -846,7 +1149,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::DragFloat("###normalOffset_", &bias.normalOffset_, 1, 0))
         {
             material->SetDepthBias(bias);
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Alpha To Coverage");
@@ -855,7 +1158,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::Checkbox("###alphaToCoverage_", &valueBool))
         {
             material->SetAlphaToCoverage(valueBool);
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Line Anti-Alias");
@@ -864,7 +1167,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::Checkbox("###lineAntiAlias_", &valueBool))
         {
             material->SetLineAntiAlias(valueBool);
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Occlusion");
@@ -873,7 +1176,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::Checkbox("###occlusion_", &valueBool))
         {
             material->SetOcclusion(valueBool);
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         ui::TextUnformatted("Render Order");
@@ -882,7 +1185,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         if (ui::DragInt("###renderOrder_", &valueInt, 1, 0, 0xFF))
         {
             material->SetRenderOrder(static_cast<unsigned char>(valueInt));
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
 
         for (unsigned i = 0; i < material->GetNumTechniques(); i++)
@@ -902,7 +1205,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
             if (handleDragAndDrop(Technique::GetTypeStatic(), resource))
             {
                 material->SetTechnique(i, DynamicCast<Technique>(resource), tech.qualityLevel_, tech.lodDistance_);
-                material->SaveFile(cache->GetResourceFileName(material->GetName()));
+                onMaterialModified();
                 resource.Reset();
             }
 
@@ -914,7 +1217,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
                     for (auto j = i + 1; j < material->GetNumTechniques(); j++)
                         material->SetTechnique(j - 1, material->GetTechnique(j));
                     material->SetNumTechniques(material->GetNumTechniques() - 1);
-                    material->SaveFile(cache->GetResourceFileName(material->GetName()));
+                    onMaterialModified();
                     ui::PopID();
                     break;
                 }
@@ -927,12 +1230,12 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
                 ui::TextUnformatted("LOD Distance");
                 NextColumn();
                 if (ui::DragFloat("###lodDistance_", &tech.lodDistance_))
-                    material->SaveFile(cache->GetResourceFileName(material->GetName()));
+                    onMaterialModified();
 
                 ui::TextUnformatted("Quality");
                 NextColumn();
                 if (ui::DragInt("###qualityLevel_", (int*)&tech.qualityLevel_))
-                    material->SaveFile(cache->GetResourceFileName(material->GetName()));
+                    onMaterialModified();
 
                 ui::Unindent(attributeIndentLevel);
             }
@@ -945,7 +1248,7 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
         {
             material->SetNumTechniques(material->GetNumTechniques() + 1);
             material->SetTechnique(material->GetNumTechniques() - 1, dynamic_cast<Technique*>(resource.Get()));
-            material->SaveFile(cache->GetResourceFileName(material->GetName()));
+            onMaterialModified();
         }
         ui::Unindent(attributeIndentLevel);
     }
@@ -953,6 +1256,14 @@ bool AttributeInspector::RenderResourceRef(StringHash type, const String& name,
     return false;
 }
 
+void AttributeInspector::SaveResource(Resource* resource)
+{
+    if (auto saver = GetSubsystem<ResourceSaver>())
+        saver->MarkDirty(resource);
+    else
+        resource->SaveFile(GetSubsystem<ResourceCache>()->GetResourceFileName(resource->GetName()));
+}
+
 void AttributeInspector::CopyEffectsFrom(Viewport* source)
 {
     effectSource_ = source;
@@ -32,6 +32,7 @@
 namespace Urho3D
 {
 
+class Resource;
 class Viewport;
 
 class AttributeInspector : public Object
@@ -43,30 +44,93 @@ public:
 
     /// Render attribute inspector widgets of multiple items.
     void RenderAttributes(const PODVector<Serializable*>& items);
+    /// Render attribute inspector widgets of groups of items. Items of a group must be of the same type. Attributes of
+    /// a group are rendered once, modifications are applied to all items of the group and attributes whose values
+    /// differ are marked.
+    void RenderAttributes(const Vector<PODVector<Serializable*>>& groups);
     /// Render attribute inspector widgets.
     void RenderAttributes(Serializable* item);
     /// Have resource views copy renderpath from source viewport.
     void CopyEffectsFrom(Viewport* source);
     /// Automatically creates two columns where first column is as wide as longest label.
     void NextColumn();
+    /// Send E_ATTRIBUTEINSPECTOATTRIBUTE for every rendered attribute again on next frame. Should be called when
+    /// listener customizes attributes differently even though their values did not change.
+    void InvalidateCustomization();
 
 protected:
+    /// Result of attribute customization by E_ATTRIBUTEINSPECTOATTRIBUTE listeners.
+    struct AttributeCustomization
+    {
+        /// Value of attribute when it was customized.
+        Variant value_;
+        /// Color of attribute label.
+        Color color_;
+        /// Tooltip of attribute label.
+        String tooltip_;
+        /// Flag indicating that attribute is not rendered.
+        bool hidden_ = false;
+        /// Flag indicating that customization is up to date.
+        bool valid_ = false;
+    };
+    /// Customization of all attributes of a single item.
+    struct ItemCustomization
+    {
+        /// Type of item.
+        StringHash type_;
+        /// Customization of attributes, indexed same as attributes of item.
+        Vector<AttributeCustomization> attributes_;
+    };
+    /// Attributes whose values differ among items of a group.
+    struct MixedValues
+    {
+        /// Flags of attributes whose values differ, result of last complete scan.
+        PODVector<bool> mixed_;
+        /// Flags of attributes whose values differ, gathered by scan in progress.
+        PODVector<bool> scanMixed_;
+        /// Values of first item at the start of scan in progress.
+        Vector<Variant> reference_;
+        /// Storage reused for reading values of items.
+        Variant value_;
+        /// Index of next item compared by scan in progress. 0 when new scan should start.
+        unsigned cursor_ = 0;
+    };
+
+    /// Render attribute inspector widgets of current groups.
+    void RenderGroups();
+    /// Reset state that belongs to previously rendered items.
+    void OnItemsChanged();
+    /// Continue comparing attribute values of items in a group. Budget is a number of attribute values that may be
+    /// read, it is decreased by number of values read.
+    void UpdateMixedValues(const PODVector<Serializable*>& group, MixedValues& mixedValues, unsigned& budget);
+
+
     /// Render value widget of single attribute.
     /// \returns true if value was modified.
     bool RenderSingleAttribute(const AttributeInfo& info, Variant& value, bool expanded);
     /// Render ui for single resource ref attribute.
     bool RenderResourceRef(StringHash type, const String& name, String& result, bool expanded);
+    /// Save modified resource. Saving is deferred and done in background when ResourceSaver subsystem is registered.
+    void SaveResource(Resource* resource);
     /// Render single attribute label.
     bool RenderAttributeLabel(const AttributeInfo& info, Color color, bool expandable);
 
     /// A filter value. Attributes whose titles do not contain substring sored in this variable will not be rendered.
     std::array<char, 0x100> filter_;
-    /// Last serializable whose attribute list was rendered.
-    PODVector<Serializable*> lastSerializables_;
+    /// Groups of serializables whose attribute lists were rendered last.
+    Vector<PODVector<Serializable*>> groups_;
+    /// Filter value used when attributes were customized.
+    String lastFilter_;
+    /// Cached customization of attributes of last rendered serializables.
+    HashMap<Serializable*, ItemCustomization> customizations_;
     /// Name of attribute that was modified on last frame.
     const char* modifiedLastFrame_ = nullptr;
-    /// Value of attribute before modifying it started.
-    Variant originalValue_;
+    /// Values of attribute of every item in a group before modifying it started.
+    Vector<Variant> originalValues_;
+    /// Value of attribute of one item, reused when modifying multiple items.
+    Variant itemValue_;
+    /// Attributes whose values differ among items, for every group of multiple items. Keyed by first item of group.
+    HashMap<Serializable*, MixedValues> mixedValues_;
     /// Max width of attribute label.
     int maxWidth_ = 0;
     /// Viewport from which rendering path and postprocess effects should be copied.
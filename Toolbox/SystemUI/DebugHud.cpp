@@ -232,6 +232,8 @@ void DebugHud::RenderUi(VariantMap& eventData)
             ui::Text("Lights %u", renderer->GetNumLights(true));
             ui::Text("Shadowmaps %u", renderer->GetNumShadowMaps(true));
             ui::Text("Occluders %u", renderer->GetNumOccluders(true));
+            if (auto systemUI = GetSubsystem<SystemUI>())
+                ui::Text("UI state changes %u", systemUI->GetNumStateChanges());
 
             for (HashMap<String, String>::ConstIterator i = appStats_.Begin(); i != appStats_.End(); ++i)
                 ui::Text("%s %s", i->first_.CString(), i->second_.CString());
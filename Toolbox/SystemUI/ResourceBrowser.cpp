@@ -24,104 +24,246 @@
 #include "ImGuiDock.h"
 #include "SystemUI/SystemUI.h"
 #include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Texture2D.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/IO/FileSystem.h>
 #include <IconFontCppHeaders/IconsFontAwesome.h>
 #include "Widgets.h"
 #include "IO/ContentUtilities.h"
+#include "IO/ResourceDependencyGraph.h"
+#include "IO/ResourceDirectoryIndex.h"
+#include "IO/ResourcePreloader.h"
+#include "IO/ResourceSearchIndex.h"
+#include "Graphics/ThumbnailService.h"
 
 
 namespace Urho3D
 {
 
+/// Time in microseconds spent searching every frame.
+static const unsigned SEARCH_BUDGET = 1000;
+
+/// Show thumbnail of hovered file and begin dragging it.
+static void FileItemHovered(Context* context, const String& resourceName)
+{
+    if (!ui::IsItemHovered())
+        return;
+
+    if (auto thumbnails = context->GetSubsystem<ThumbnailService>())
+    {
+        if (Texture2D* thumbnail = thumbnails->GetThumbnail(resourceName))
+        {
+            ui::BeginTooltip();
+            ui::Image(thumbnail, ToImGui(IntVector2(thumbnail->GetWidth(), thumbnail->GetHeight())));
+            ui::EndTooltip();
+        }
+    }
+
+    if (ui::IsMouseDragging())
+    {
+        auto systemUI = context->GetSubsystem<SystemUI>();
+        if (!systemUI->HasDragData())
+            systemUI->SetDragData(resourceName);
+    }
+}
+
+/// Start loading selected file and resources it references, so that opening it does not stall.
+static void PreloadFile(Context* context, const String& resourceName)
+{
+    if (auto preloader = context->GetSubsystem<ResourcePreloader>())
+        preloader->Preload(resourceName);
+}
+
+/// List resources in a submenu. Return true and set selected when one of them is clicked.
+static bool ResourceListMenu(const char* label, const Vector<String>& resources, String& selected)
+{
+    bool result = false;
+    if (ui::BeginMenu(label, !resources.Empty()))
+    {
+        for (const auto& resource : resources)
+        {
+            if (ui::MenuItem(resource.CString()))
+            {
+                selected = resource;
+                result = true;
+            }
+        }
+        ui::EndMenu();
+    }
+    return result;
+}
+
+/// Show context menu listing resources used by a file and resources using it. Return true and set selected when one
+/// of them is clicked.
+static bool FileItemContextMenu(Context* context, const String& resourceName, String& selected)
+{
+    auto graph = context->GetSubsystem<ResourceDependencyGraph>();
+    if (graph == nullptr || !ui::BeginPopupContextItem())
+        return false;
+
+    bool result = ResourceListMenu("Uses", graph->GetUses(resourceName), selected);
+    result |= ResourceListMenu("Used by", graph->GetUsedBy(resourceName), selected);
+    Vector<String> allUsedBy;
+    graph->GetAllUsedBy(resourceName, allUsedBy);
+    result |= ResourceListMenu("Used by (including indirectly)", allUsedBy, selected);
+    if (!graph->IsReady())
+        ui::TextDisabled("Scanning resources...");
+
+    ui::EndPopup();
+    return result;
+}
+
 bool ResourceBrowserWindow(String& selected, bool* open)
+{
+    SystemUI* systemUI = static_cast<SystemUI*>(ui::GetIO().UserData);
+    return ResourceBrowserWindow(systemUI->GetContext(), selected, open);
+}
+
+bool ResourceBrowserWindow(Context* context, String& selected, bool* open)
 {
     struct State
     {
         String path;
         String selected;
+        /// Revision of directory listing labels were built for.
+        unsigned revision = 0;
+        /// Labels of directories followed by labels of files.
+        Vector<String> labels;
+        /// Search query typed by user.
+        char searchBuffer[128]{};
+        /// Search in progress.
+        ResourceSearch search;
     };
 
     bool result = false;
-    SystemUI* systemUI = static_cast<SystemUI*>(ui::GetIO().UserData);
-    auto fs = systemUI->GetSubsystem<FileSystem>();
-    auto cache = systemUI->GetSubsystem<ResourceCache>();
+    auto index = context->GetSubsystem<ResourceDirectoryIndex>();
+    if (index == nullptr)
+    {
+        index = new ResourceDirectoryIndex(context);
+        context->RegisterSubsystem(index);
+    }
+    auto searchIndex = context->GetSubsystem<ResourceSearchIndex>();
+    if (searchIndex == nullptr)
+    {
+        searchIndex = new ResourceSearchIndex(context);
+        context->RegisterSubsystem(searchIndex);
+    }
+
     if (ui::BeginDock("Resources", open))
     {
         State* state = ui::GetUIState<State>();
 
-        Vector<String> mergedDirs;
-        Vector<String> mergedFiles;
+        ui::TextUnformatted(ICON_FA_SEARCH);
+        ui::SameLine();
+        if (ui::InputText("###search", state->searchBuffer, IM_ARRAYSIZE(state->searchBuffer)))
+            searchIndex->BeginSearch(state->search, state->searchBuffer);
 
-        for (const auto& dir: cache->GetResourceDirs())
+        if (!state->search.query_.Empty())
         {
-            Vector<String> items;
-            fs->ScanDir(items, dir + state->path, "", SCAN_FILES, false);
-            for (const auto& item: items)
-            {
-                if (item == "." || item == ".." || mergedFiles.Contains(item))
-                    continue;
-                mergedFiles.Push(item);
-            }
+            // Results are appended while index is scanned, list grows over multiple frames.
+            if (!searchIndex->UpdateSearch(state->search, SEARCH_BUDGET))
+                ui::TextDisabled("Searching...");
 
-            items.Clear();
-            fs->ScanDir(items, dir + state->path, "", SCAN_DIRS, false);
-            for (const auto& item: items)
+            const auto& entries = searchIndex->GetEntries();
+            ImGuiListClipper clipper(state->search.results_.Size(), ui::GetTextLineHeightWithSpacing());
+            while (clipper.Step())
             {
-                if (item == "." || item == ".." || mergedDirs.Contains(item))
-                    continue;
-                mergedDirs.Push(item);
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+                {
+                    const String& item = entries[state->search.results_[i]].resourceName_;
+                    String label = GetFileIcon(item) + " " + item;
+                    switch (ui::DoubleClickSelectable(label.CString(), state->selected == item))
+                    {
+                    case 1:
+                        state->selected = item;
+                        PreloadFile(context, item);
+                        break;
+                    case 2:
+                        selected = item;
+                        result = true;
+                        break;
+                    default:
+                        break;
+                    }
+                    FileItemHovered(context, item);
+                    result |= FileItemContextMenu(context, item, selected);
+                }
             }
+            ui::EndDock();
+            return result;
         }
 
-        switch (ui::DoubleClickSelectable("..", state->selected == ".."))
-        {
-        case 1:
-            state->selected = "..";
-            break;
-        case 2:
-            state->path = GetParentPath(state->path);
-            break;
-        default:
-            break;
-        }
+        const DirectoryListing& listing = index->GetListing(state->path);
 
-        Sort(mergedDirs.Begin(), mergedDirs.End());
-        for (const auto& item: mergedDirs)
+        if (state->revision != listing.revision_)
         {
-            switch (ui::DoubleClickSelectable((ICON_FA_FOLDER " " + item).CString(), state->selected == item))
-            {
-            case 1:
-                state->selected = item;
-                break;
-            case 2:
-                state->path += AddTrailingSlash(item);
-                state->selected.Clear();
-                break;
-            default:
-                break;
-            }
+            state->revision = listing.revision_;
+            state->labels.Clear();
+            state->labels.Reserve(listing.dirs_.Size() + listing.files_.Size());
+            for (const auto& item: listing.dirs_)
+                state->labels.Push(ICON_FA_FOLDER " " + item);
+            for (const auto& item: listing.files_)
+                state->labels.Push(GetFileIcon(item) + " " + item);
         }
 
-        Sort(mergedFiles.Begin(), mergedFiles.End());
-        for (const auto& item: mergedFiles)
+        // Only visible entries are rendered. First entry is parent directory, followed by directories and files.
+        int numDirs = listing.dirs_.Size();
+        ImGuiListClipper clipper(1 + state->labels.Size(), ui::GetTextLineHeightWithSpacing());
+        while (clipper.Step())
         {
-            auto title = GetFileIcon(item) + " " + item;
-            switch (ui::DoubleClickSelectable(title.CString(), state->selected == item))
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
             {
-            case 1:
-                state->selected = item;
-                break;
-            case 2:
-                selected = state->path + item;
-                result = true;
-                break;
-            default:
-                break;
-            }
+                if (i == 0)
+                {
+                    switch (ui::DoubleClickSelectable("..", state->selected == ".."))
+                    {
+                    case 1:
+                        state->selected = "..";
+                        break;
+                    case 2:
+                        state->path = GetParentPath(state->path);
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                else if (i - 1 < numDirs)
+                {
+                    const String& item = listing.dirs_[i - 1];
+                    switch (ui::DoubleClickSelectable(state->labels[i - 1].CString(), state->selected == item))
+                    {
+                    case 1:
+                        state->selected = item;
+                        break;
+                    case 2:
+                        state->path += AddTrailingSlash(item);
+                        state->selected.Clear();
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                else
+                {
+                    const String& item = listing.files_[i - 1 - numDirs];
+                    switch (ui::DoubleClickSelectable(state->labels[i - 1].CString(), state->selected == item))
+                    {
+                    case 1:
+                        state->selected = item;
+                        PreloadFile(context, state->path + item);
+                        break;
+                    case 2:
+                        selected = state->path + item;
+                        result = true;
+                        break;
+                    default:
+                        break;
+                    }
 
-            if (ui::IsItemHovered() && ui::IsMouseDragging() && !systemUI->HasDragData())
-                systemUI->SetDragData(state->path + item);
+                    FileItemHovered(context, state->path + item);
+                    result |= FileItemContextMenu(context, state->path + item, selected);
+                }
+            }
         }
     }
     ui::EndDock();
@@ -31,5 +31,7 @@ namespace Urho3D
 
 /// Create docked resource browser window.
 bool ResourceBrowserWindow(String& selected, bool* open);
+/// Create docked resource browser window. Resource directories are accessed through subsystems of specified context.
+bool ResourceBrowserWindow(Context* context, String& selected, bool* open);
 
 }
@@ -27,6 +27,9 @@
 #include "Urho3D/Engine/EngineEvents.h"
 #include "Urho3D/Graphics/GraphicsEvents.h"
 #include "Urho3D/Graphics/Graphics.h"
+#include "Urho3D/IO/Compression.h"
+#include "Urho3D/IO/File.h"
+#include "Urho3D/IO/FileSystem.h"
 #include "Urho3D/Resource/ResourceCache.h"
 #include "SystemUI.h"
 #include "Console.h"
@@ -40,6 +43,8 @@ namespace Urho3D
 {
 
 const float defaultFontSize = 14.f;
+/// Version of font atlas cache file format.
+static const unsigned FONT_ATLAS_CACHE_VERSION = 1;
 
 SystemUI::SystemUI(Urho3D::Context* context)
     : Object(context)
@@ -72,12 +77,9 @@ SystemUI::SystemUI(Urho3D::Context* context)
     io.UserData = this;
 
     SetScale();
+    // Font atlas is built before first frame, after application had a chance to add more fonts.
     AddFont("Fonts/DejaVuSansMono.ttf", defaultFontSize, nullptr);
-    ReallocateFontTexture();
     UpdateProjectionMatrix();
-    // Initializes ImGui. ImGui::Render() can not be called unless imgui is initialized. This call avoids initialization
-    // check on every frame in E_ENDRENDERING.
-    ImGui::NewFrame();
 
     // Subscribe to events
     SubscribeToEvent(E_SDLRAWINPUT, std::bind(&SystemUI::OnRawEvent, this, _2));
@@ -86,11 +88,16 @@ SystemUI::SystemUI(Urho3D::Context* context)
     {
         float timeStep = GetSubsystem<Time>()->GetTimeStep();
         ImGui::GetIO().DeltaTime = timeStep > 0.0f ? timeStep : 1.0f / 60.0f;
+        if (fontsDirty_)
+            ReallocateFontTexture();
         ImGui::NewFrame();
         ImGuizmo::BeginFrame();
     });
     SubscribeToEvent(E_ENDRENDERING, [&](StringHash, VariantMap&)
     {
+        // ImGui is initialized by first ImGui::NewFrame() in E_INPUTEND.
+        if (!GImGui->Initialized)
+            return;
         URHO3D_PROFILE(SystemUiRender);
         OnUpdate();
         ImGui::Render();
@@ -179,81 +186,244 @@ void SystemUI::OnRawEvent(VariantMap& args)
     }
 }
 
-void SystemUI::OnRenderDrawLists(ImDrawData* data)
+/// Return hash of memory block, processed in 32-bit words. Used only for detecting changes.
+static unsigned HashMemory(unsigned hash, const void* data, unsigned size)
 {
-    auto graphics = GetSubsystem<Graphics>();
-    // Engine does not render when window is closed or device is lost
-    assert(graphics && graphics->IsInitialized() && !graphics->IsDeviceLost());
-
-    ImGuiIO& io = ImGui::GetIO();
+    auto bytes = static_cast<const unsigned char*>(data);
+    unsigned i = 0;
+    for (; i + sizeof(unsigned) <= size; i += sizeof(unsigned))
+    {
+        unsigned word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 16777619u;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
 
+/// Return hash of geometry and commands of all draw lists.
+static unsigned HashDrawData(const ImDrawData* data)
+{
+    unsigned hash = 2166136261u;
     for (int n = 0; n < data->CmdListsCount; n++)
     {
         const ImDrawList* cmdList = data->CmdLists[n];
-        unsigned int idxBufferOffset = 0;
-
-        // Resize vertex and index buffers on the fly. Once buffer becomes too small for data that is to be rendered
-        // we reallocate buffer to be twice as big as we need now. This is done in order to minimize memory reallocation
-        // in rendering loop.
-        if (cmdList->VtxBuffer.Size > vertexBuffer_.GetVertexCount())
+        hash = HashMemory(hash, cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert));
+        hash = HashMemory(hash, cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
+        // Commands are hashed field by field, because padding of the structure is not initialized.
+        for (const ImDrawCmd* cmd = cmdList->CmdBuffer.begin(); cmd != cmdList->CmdBuffer.end(); cmd++)
         {
-            PODVector<VertexElement> elems = {VertexElement(TYPE_VECTOR2, SEM_POSITION),
-                                              VertexElement(TYPE_VECTOR2, SEM_TEXCOORD),
-                                              VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR)
-            };
-            vertexBuffer_.SetSize((unsigned int)(cmdList->VtxBuffer.Size * 2), elems, true);
+            hash = HashMemory(hash, &cmd->ElemCount, sizeof(cmd->ElemCount));
+            hash = HashMemory(hash, &cmd->ClipRect, sizeof(cmd->ClipRect));
+            hash = HashMemory(hash, &cmd->TextureId, sizeof(cmd->TextureId));
+            hash = HashMemory(hash, &cmd->UserCallback, sizeof(cmd->UserCallback));
         }
-        if (cmdList->IdxBuffer.Size > indexBuffer_.GetIndexCount())
-            indexBuffer_.SetSize((unsigned int)(cmdList->IdxBuffer.Size * 2), false, true);
+        // Lists with moved boundaries may produce same stream of data.
+        hash = HashMemory(hash, &cmdList->VtxBuffer.Size, sizeof(cmdList->VtxBuffer.Size));
+    }
+    return hash;
+}
 
+void SystemUI::SetSkipUnchangedFrames(bool enable)
+{
+    skipUnchangedFrames_ = enable;
+    drawDataHash_ = 0;
+    numUnchangedFrames_ = 0;
+}
+
+bool SystemUI::UploadDrawData(ImDrawData* data, bool rebaseIndices)
+{
+    // Geometry of all draw lists is uploaded at once. Indices of every draw list are relative to it's first vertex,
+    // which is passed to draw calls as base vertex index, or added to indices when base vertex is not supported.
+    auto vertices = static_cast<ImDrawVert*>(vertexBuffer_.Lock(0, (unsigned int)data->TotalVtxCount, true));
+    auto indices = static_cast<unsigned char*>(indexBuffer_.Lock(0, (unsigned int)data->TotalIdxCount, true));
+    if (vertices == nullptr || indices == nullptr)
+    {
+        if (vertices != nullptr)
+            vertexBuffer_.Unlock();
+        if (indices != nullptr)
+            indexBuffer_.Unlock();
+        return false;
+    }
+
+    unsigned firstVertex = 0;
+    for (int n = 0; n < data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmdList = data->CmdLists[n];
 #if (defined(_WIN32) && !defined(URHO3D_D3D11) && !defined(URHO3D_OPENGL)) || defined(URHO3D_D3D9)
         for (int i = 0; i < cmdList->VtxBuffer.Size; i++)
         {
-            ImDrawVert& v = cmdList->VtxBuffer.Data[i];
+            ImDrawVert v = cmdList->VtxBuffer.Data[i];
             v.pos.x += 0.5f;
             v.pos.y += 0.5f;
+            vertices[i] = v;
+        }
+#else
+        memcpy(vertices, cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert));
+#endif
+        if (!rebaseIndices)
+            memcpy(indices, cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
+        else if (indexBuffer_.GetIndexSize() == sizeof(unsigned))
+        {
+            auto dest = reinterpret_cast<unsigned*>(indices);
+            for (int i = 0; i < cmdList->IdxBuffer.Size; i++)
+                dest[i] = cmdList->IdxBuffer.Data[i] + firstVertex;
         }
+        else
+        {
+            auto dest = reinterpret_cast<unsigned short*>(indices);
+            for (int i = 0; i < cmdList->IdxBuffer.Size; i++)
+                dest[i] = (unsigned short)(cmdList->IdxBuffer.Data[i] + firstVertex);
+        }
+        vertices += cmdList->VtxBuffer.Size;
+        indices += cmdList->IdxBuffer.Size * indexBuffer_.GetIndexSize();
+        firstVertex += cmdList->VtxBuffer.Size;
+    }
+    vertexBuffer_.Unlock();
+    indexBuffer_.Unlock();
+    vertexBuffer_.ClearDataLost();
+    indexBuffer_.ClearDataLost();
+    return true;
+}
+
+void SystemUI::OnRenderDrawLists(ImDrawData* data)
+{
+    auto graphics = GetSubsystem<Graphics>();
+    // Engine does not render when window is closed or device is lost
+    assert(graphics && graphics->IsInitialized() && !graphics->IsDeviceLost());
+
+    // When nothing changed since last frame, buffers already contain the geometry and upload is skipped.
+    bool upload = true;
+    if (skipUnchangedFrames_)
+    {
+        unsigned hash = HashDrawData(data);
+        bool unchanged = hash == drawDataHash_ && !vertexBuffer_.IsDataLost() && !indexBuffer_.IsDataLost();
+        numUnchangedFrames_ = unchanged ? numUnchangedFrames_ + 1 : 0;
+        drawDataHash_ = hash;
+        upload = !unchanged;
+    }
+
+    if (data->TotalVtxCount == 0 || data->TotalIdxCount == 0)
+        return;
+
+    // Resize vertex and index buffers on the fly. Once buffer becomes too small for data that is to be rendered
+    // we reallocate buffer to be twice as big as we need now. This is done in order to minimize memory reallocation
+    // in rendering loop.
+    if (data->TotalVtxCount > vertexBuffer_.GetVertexCount())
+    {
+        PODVector<VertexElement> elems = {VertexElement(TYPE_VECTOR2, SEM_POSITION),
+                                          VertexElement(TYPE_VECTOR2, SEM_TEXCOORD),
+                                          VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR)
+        };
+        vertexBuffer_.SetSize((unsigned int)(data->TotalVtxCount * 2), elems, true);
+        upload = true;
+    }
+
+    // OpenGL without GL3 support (GL2, GLES and WebGL) can not draw with base vertex index. Indices are rebased to
+    // refer to vertices of all draw lists, which requires 32-bit indices once there are more than 65535 vertices.
+    bool rebaseIndices = false;
+#ifdef URHO3D_OPENGL
+    rebaseIndices = !Graphics::GetGL3Support();
 #endif
+    bool largeIndices = rebaseIndices && data->TotalVtxCount > 0xFFFF;
+    if (data->TotalIdxCount > indexBuffer_.GetIndexCount() ||
+        indexBuffer_.GetIndexSize() != (largeIndices ? sizeof(unsigned) : sizeof(ImDrawIdx)))
+    {
+        indexBuffer_.SetSize((unsigned int)(data->TotalIdxCount * 2), largeIndices, true);
+        upload = true;
+    }
 
-        vertexBuffer_.SetDataRange(cmdList->VtxBuffer.Data, 0, (unsigned int)cmdList->VtxBuffer.Size, true);
-        indexBuffer_.SetDataRange(cmdList->IdxBuffer.Data, 0, (unsigned int)cmdList->IdxBuffer.Size, true);
+    if (upload && !UploadDrawData(data, rebaseIndices))
+    {
+        // Next frame must not be considered unchanged.
+        drawDataHash_ = 0;
+        return;
+    }
 
-        graphics->ClearParameterSources();
-        graphics->SetColorWrite(true);
-        graphics->SetCullMode(CULL_NONE);
-        graphics->SetDepthTest(CMP_ALWAYS);
-        graphics->SetDepthWrite(false);
-        graphics->SetFillMode(FILL_SOLID);
-        graphics->SetStencilTest(false);
-        graphics->SetVertexBuffer(&vertexBuffer_);
-        graphics->SetIndexBuffer(&indexBuffer_);
+    // Shader variations are looked up only once, instead of hashing their names and defines for every command.
+    if (vertexColorVS_.Null())
+    {
+        vertexColorVS_ = graphics->GetShader(VS, "Basic", "VERTEXCOLOR");
+        vertexColorPS_ = graphics->GetShader(PS, "Basic", "VERTEXCOLOR");
+        diffMapVS_ = graphics->GetShader(VS, "Basic", "DIFFMAP VERTEXCOLOR");
+        diffMapPS_ = graphics->GetShader(PS, "Basic", "DIFFMAP VERTEXCOLOR");
+        alphaMapPS_ = graphics->GetShader(PS, "Basic", "ALPHAMAP VERTEXCOLOR");
+    }
+
+    // Fixed pipeline state is same for all draw lists. It is set again only if user callback could have changed it.
+    // Remaining state is set only when it differs from state of previous command.
+    bool stateValid = false;
+    ShaderVariation* currentVS = nullptr;
+    ShaderVariation* currentPS = nullptr;
+    Texture2D* currentTexture = nullptr;
+    IntRect currentScissor;
+    numStateChanges_ = 0;
+
+    float elapsedTime = GetSubsystem<Time>()->GetElapsedTime();
+    unsigned vtxBufferOffset = 0;
+    unsigned idxBufferOffset = 0;
+    for (int n = 0; n < data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmdList = data->CmdLists[n];
+        unsigned listIdxOffset = idxBufferOffset;
 
         for (const ImDrawCmd* cmd = cmdList->CmdBuffer.begin(); cmd != cmdList->CmdBuffer.end(); cmd++)
         {
             if (cmd->UserCallback)
+            {
                 cmd->UserCallback(cmdList, cmd);
+                stateValid = false;
+            }
             else
             {
+                if (!stateValid)
+                {
+                    graphics->ClearParameterSources();
+                    graphics->SetColorWrite(true);
+                    graphics->SetCullMode(CULL_NONE);
+                    graphics->SetDepthTest(CMP_ALWAYS);
+                    graphics->SetDepthWrite(false);
+                    graphics->SetFillMode(FILL_SOLID);
+                    graphics->SetStencilTest(false);
+                    graphics->SetBlendMode(BLEND_ALPHA);
+                    graphics->SetVertexBuffer(&vertexBuffer_);
+                    graphics->SetIndexBuffer(&indexBuffer_);
+                    numStateChanges_++;
+                }
+
                 ShaderVariation* ps;
                 ShaderVariation* vs;
 
                 Texture2D* texture = static_cast<Texture2D*>(cmd->TextureId);
                 if (!texture)
                 {
-                    ps = graphics->GetShader(PS, "Basic", "VERTEXCOLOR");
-                    vs = graphics->GetShader(VS, "Basic", "VERTEXCOLOR");
+                    ps = vertexColorPS_;
+                    vs = vertexColorVS_;
                 }
                 else
                 {
                     // If texture contains only an alpha channel, use alpha shader (for fonts)
-                    vs = graphics->GetShader(VS, "Basic", "DIFFMAP VERTEXCOLOR");
+                    vs = diffMapVS_;
                     if (texture->GetFormat() == Graphics::GetAlphaFormat())
-                        ps = graphics->GetShader(PS, "Basic", "ALPHAMAP VERTEXCOLOR");
+                        ps = alphaMapPS_;
                     else
-                        ps = graphics->GetShader(PS, "Basic", "DIFFMAP VERTEXCOLOR");
+                        ps = diffMapPS_;
+                }
+
+                if (!stateValid || vs != currentVS || ps != currentPS)
+                {
+                    graphics->SetShaders(vs, ps);
+                    currentVS = vs;
+                    currentPS = ps;
+                    numStateChanges_++;
                 }
 
-                graphics->SetShaders(vs, ps);
+                if (graphics->NeedParameterUpdate(SP_FRAME, this))
+                {
+                    graphics->SetShaderParameter(VSP_ELAPSEDTIME, elapsedTime);
+                    graphics->SetShaderParameter(PSP_ELAPSEDTIME, elapsedTime);
+                }
                 if (graphics->NeedParameterUpdate(SP_OBJECT, this))
                     graphics->SetShaderParameter(VSP_MODEL, Matrix3x4::IDENTITY);
                 if (graphics->NeedParameterUpdate(SP_CAMERA, this))
@@ -261,56 +431,97 @@ void SystemUI::OnRenderDrawLists(ImDrawData* data)
                 if (graphics->NeedParameterUpdate(SP_MATERIAL, this))
                     graphics->SetShaderParameter(PSP_MATDIFFCOLOR, Color(1.0f, 1.0f, 1.0f, 1.0f));
 
-                float elapsedTime = GetSubsystem<Time>()->GetElapsedTime();
-                graphics->SetShaderParameter(VSP_ELAPSEDTIME, elapsedTime);
-                graphics->SetShaderParameter(PSP_ELAPSEDTIME, elapsedTime);
-
                 IntRect scissor = IntRect(int(cmd->ClipRect.x * uiZoom_), int(cmd->ClipRect.y * uiZoom_),
                                           int(cmd->ClipRect.z * uiZoom_), int(cmd->ClipRect.w * uiZoom_));
+                if (!stateValid || scissor != currentScissor)
+                {
+                    graphics->SetScissorTest(true, scissor);
+                    currentScissor = scissor;
+                    numStateChanges_++;
+                }
 
-                graphics->SetBlendMode(BLEND_ALPHA);
-                graphics->SetScissorTest(true, scissor);
-                graphics->SetTexture(0, texture);
-                graphics->Draw(TRIANGLE_LIST, idxBufferOffset, cmd->ElemCount, 0, 0,
-                                vertexBuffer_.GetVertexCount());
-                idxBufferOffset += cmd->ElemCount;
+                if (!stateValid || texture != currentTexture)
+                {
+                    graphics->SetTexture(0, texture);
+                    currentTexture = texture;
+                    numStateChanges_++;
+                }
+
+                stateValid = true;
+                if (rebaseIndices)
+                    graphics->Draw(TRIANGLE_LIST, listIdxOffset, cmd->ElemCount, 0,
+                        (unsigned int)data->TotalVtxCount);
+                else
+                {
+                    graphics->Draw(TRIANGLE_LIST, listIdxOffset, cmd->ElemCount, vtxBufferOffset, 0,
+                        (unsigned int)cmdList->VtxBuffer.Size);
+                }
             }
+            listIdxOffset += cmd->ElemCount;
         }
+
+        vtxBufferOffset += cmdList->VtxBuffer.Size;
+        idxBufferOffset += cmdList->IdxBuffer.Size;
     }
     graphics->SetScissorTest(false);
 }
 
 ImFont* SystemUI::AddFont(const String& fontPath, float size, const unsigned short* ranges, bool merge)
 {
-    auto io = ImGui::GetIO();
+    auto& io = ImGui::GetIO();
 
     fontSizes_.Push(size);
 
     if (size == 0)
     {
-        if (io.Fonts->Fonts.empty())
+        // Fonts are not built yet, size is taken from their configuration.
+        if (io.Fonts->ConfigData.empty())
             return nullptr;
-        size = io.Fonts->Fonts.back()->FontSize;
+        size = io.Fonts->ConfigData.back().SizePixels;
     }
     else
         size *= fontScale_;
 
-    if (auto fontFile = GetSubsystem<ResourceCache>()->GetFile(fontPath))
+    // Caller's ranges may be temporary, while atlas is built later and may be rebuilt at different scale.
+    if (ranges != nullptr)
     {
-        PODVector<uint8_t> data;
+        unsigned length = 0;
+        while (ranges[length] != 0)
+            length++;
+        SharedArrayPtr<unsigned short> rangesCopy(new unsigned short[length + 1]);
+        memcpy(rangesCopy.Get(), ranges, (length + 1) * sizeof(unsigned short));
+        fontRanges_.Push(rangesCopy);
+        ranges = rangesCopy.Get();
+    }
+
+    // Font file is read once, directly into a buffer owned by SystemUI. Fonts of different sizes share it and atlas
+    // may be rebuilt at a different scale without reading the file again.
+    PODVector<unsigned char>& data = fontData_[fontPath];
+    if (data.Empty())
+    {
+        SharedPtr<File> fontFile = GetSubsystem<ResourceCache>()->GetFile(fontPath);
+        if (fontFile.Null() || fontFile->GetSize() == 0)
+        {
+            fontData_.Erase(fontPath);
+            return nullptr;
+        }
         data.Resize(fontFile->GetSize());
-        auto bytesLen = fontFile->Read(&data.Front(), data.Size());
-        ImFontConfig cfg;
-        cfg.MergeMode = merge;
-        cfg.FontDataOwnedByAtlas = false;
-        cfg.PixelSnapH = true;
-        if (auto newFont = ImGui::GetIO().Fonts->AddFontFromMemoryTTF(&data.Front(), bytesLen, size, &cfg, ranges))
+        if (fontFile->Read(&data.Front(), data.Size()) != data.Size())
         {
-            ReallocateFontTexture();
-            return newFont;
+            fontData_.Erase(fontPath);
+            return nullptr;
         }
     }
-    return nullptr;
+
+    ImFontConfig cfg;
+    cfg.MergeMode = merge;
+    // Atlas copies data it does not own. Ownership is claimed only to avoid that copy and given back right away.
+    cfg.FontDataOwnedByAtlas = true;
+    cfg.PixelSnapH = true;
+    ImFont* newFont = io.Fonts->AddFontFromMemoryTTF(&data.Front(), data.Size(), size, &cfg, ranges);
+    io.Fonts->ConfigData.back().FontDataOwnedByAtlas = false;
+    fontsDirty_ = true;
+    return newFont;
 }
 
 ImFont* SystemUI::AddFont(const Urho3D::String& fontPath, float size,
@@ -321,12 +532,27 @@ ImFont* SystemUI::AddFont(const Urho3D::String& fontPath, float size,
 
 void SystemUI::ReallocateFontTexture()
 {
-    auto io = ImGui::GetIO();
+    URHO3D_PROFILE(ReallocateFontTexture);
+
+    auto& io = ImGui::GetIO();
+    fontsDirty_ = false;
+
+    // Atlas without fonts is built with default font. It is added here so that it takes part in cache key.
+    if (io.Fonts->ConfigData.empty())
+        io.Fonts->AddFontDefault();
+
+    unsigned key = GetFontAtlasKey();
+    if (!LoadFontAtlas(key))
+    {
+        // Rasterize all fonts.
+        unsigned char* alpha;
+        io.Fonts->GetTexDataAsAlpha8(&alpha, nullptr, nullptr);
+        SaveFontAtlas(key);
+    }
+
     // Create font texture.
     unsigned char* pixels;
     int width, height;
-
-    io.Fonts->AddFontDefault();
     io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
 
     if (fontTexture_.Null())
@@ -346,6 +572,232 @@ void SystemUI::ReallocateFontTexture()
     io.Fonts->ClearTexData();
 }
 
+unsigned SystemUI::GetFontAtlasKey() const
+{
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    unsigned hash = 2166136261u;
+    hash = HashMemory(hash, &FONT_ATLAS_CACHE_VERSION, sizeof(FONT_ATLAS_CACHE_VERSION));
+    hash = HashMemory(hash, IMGUI_VERSION, sizeof(IMGUI_VERSION));
+    hash = HashMemory(hash, &fontScale_, sizeof(fontScale_));
+    hash = HashMemory(hash, &atlas->TexDesiredWidth, sizeof(atlas->TexDesiredWidth));
+    hash = HashMemory(hash, &atlas->TexGlyphPadding, sizeof(atlas->TexGlyphPadding));
+    for (const ImFontConfig& cfg : atlas->ConfigData)
+    {
+        hash = HashMemory(hash, cfg.FontData, (unsigned)cfg.FontDataSize);
+        hash = HashMemory(hash, &cfg.FontNo, sizeof(cfg.FontNo));
+        hash = HashMemory(hash, &cfg.SizePixels, sizeof(cfg.SizePixels));
+        hash = HashMemory(hash, &cfg.OversampleH, sizeof(cfg.OversampleH));
+        hash = HashMemory(hash, &cfg.OversampleV, sizeof(cfg.OversampleV));
+        hash = HashMemory(hash, &cfg.PixelSnapH, sizeof(cfg.PixelSnapH));
+        hash = HashMemory(hash, &cfg.GlyphExtraSpacing, sizeof(cfg.GlyphExtraSpacing));
+        hash = HashMemory(hash, &cfg.GlyphOffset, sizeof(cfg.GlyphOffset));
+        hash = HashMemory(hash, &cfg.MergeMode, sizeof(cfg.MergeMode));
+        // Atlas build replaces missing ranges with default ones, key must not change after first build.
+        const ImWchar* ranges = cfg.GlyphRanges ? cfg.GlyphRanges : atlas->GetGlyphRangesDefault();
+        unsigned numRanges = 0;
+        while (ranges[numRanges] != 0)
+            numRanges++;
+        hash = HashMemory(hash, ranges, numRanges * sizeof(ImWchar));
+        int fontIndex = 0;
+        while (fontIndex < atlas->Fonts.Size && atlas->Fonts[fontIndex] != cfg.DstFont)
+            fontIndex++;
+        hash = HashMemory(hash, &fontIndex, sizeof(fontIndex));
+    }
+    return hash;
+}
+
+bool SystemUI::LoadFontAtlas(unsigned key)
+{
+    if (fontAtlasCachePath_.Empty() || !GetSubsystem<FileSystem>()->FileExists(fontAtlasCachePath_))
+        return false;
+
+    File file(context_);
+    if (!file.Open(fontAtlasCachePath_, FILE_READ))
+        return false;
+
+    if (file.ReadFileID() != "FATL" || file.ReadUInt() != FONT_ATLAS_CACHE_VERSION || file.ReadUInt() != key)
+        return false;
+
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    if (file.ReadVLE() != (unsigned)atlas->Fonts.Size)
+        return false;
+
+    // Baked metrics and glyphs of a single font.
+    struct BakedFont
+    {
+        float fontSize_;
+        float ascent_;
+        float descent_;
+        int metricsTotalSurface_;
+        ImWchar fallbackChar_;
+        PODVector<ImFontGlyph> glyphs_;
+    };
+
+    // Everything is read before atlas is modified, so that truncated file leaves fonts intact.
+    int width = file.ReadInt();
+    int height = file.ReadInt();
+    Vector2 whitePixel = file.ReadVector2();
+
+    ImGuiMouseCursorData cursors[ImGuiMouseCursor_Count_];
+    for (int type = 0; type < ImGuiMouseCursor_Count_; type++)
+    {
+        ImGuiMouseCursorData& cursor = cursors[type];
+        cursor.Type = type;
+        cursor.HotOffset = ToImGui(file.ReadVector2());
+        cursor.Size = ToImGui(file.ReadVector2());
+        for (int i = 0; i < 2; i++)
+        {
+            cursor.TexUvMin[i] = ToImGui(file.ReadVector2());
+            cursor.TexUvMax[i] = ToImGui(file.ReadVector2());
+        }
+    }
+
+    Vector<BakedFont> fonts((unsigned)atlas->Fonts.Size);
+    for (BakedFont& font : fonts)
+    {
+        font.fontSize_ = file.ReadFloat();
+        font.ascent_ = file.ReadFloat();
+        font.descent_ = file.ReadFloat();
+        font.metricsTotalSurface_ = file.ReadInt();
+        font.fallbackChar_ = file.ReadUShort();
+        font.glyphs_.Resize(file.ReadVLE());
+        for (ImFontGlyph& glyph : font.glyphs_)
+        {
+            glyph.Codepoint = file.ReadUShort();
+            glyph.AdvanceX = file.ReadFloat();
+            glyph.X0 = file.ReadFloat();
+            glyph.Y0 = file.ReadFloat();
+            glyph.X1 = file.ReadFloat();
+            glyph.Y1 = file.ReadFloat();
+            glyph.U0 = file.ReadFloat();
+            glyph.V0 = file.ReadFloat();
+            glyph.U1 = file.ReadFloat();
+            glyph.V1 = file.ReadFloat();
+        }
+    }
+
+    unsigned numPixels = (unsigned)(width * height);
+    unsigned compressedSize = file.ReadUInt();
+    if (width <= 0 || height <= 0 || file.IsEof() || compressedSize > file.GetSize() - file.GetPosition())
+        return false;
+
+    SharedArrayPtr<unsigned char> compressed(new unsigned char[compressedSize]);
+    if (file.Read(compressed.Get(), compressedSize) != compressedSize)
+        return false;
+
+    auto alpha = static_cast<unsigned char*>(ImGui::MemAlloc(numPixels));
+    if (DecompressData(alpha, compressed.Get(), numPixels) != compressedSize)
+    {
+        ImGui::MemFree(alpha);
+        return false;
+    }
+
+    atlas->ClearTexData();
+    atlas->TexPixelsAlpha8 = alpha;
+    atlas->TexWidth = width;
+    atlas->TexHeight = height;
+    atlas->TexUvWhitePixel = ToImGui(whitePixel);
+
+    for (int i = 0; i < atlas->Fonts.Size; i++)
+    {
+        ImFont* font = atlas->Fonts[i];
+        const BakedFont& baked = fonts[i];
+        font->ClearOutputData();
+        font->FontSize = baked.fontSize_;
+        font->Ascent = baked.ascent_;
+        font->Descent = baked.descent_;
+        font->MetricsTotalSurface = baked.metricsTotalSurface_;
+        font->FallbackChar = baked.fallbackChar_;
+        font->ContainerAtlas = atlas;
+        for (ImFontConfig& cfg : atlas->ConfigData)
+        {
+            if (cfg.DstFont != font)
+                continue;
+            if (font->ConfigData == nullptr)
+                font->ConfigData = &cfg;
+            font->ConfigDataCount++;
+        }
+        font->Glyphs.resize(baked.glyphs_.Size());
+        if (!baked.glyphs_.Empty())
+            memcpy(font->Glyphs.Data, &baked.glyphs_.Front(), baked.glyphs_.Size() * sizeof(ImFontGlyph));
+        font->BuildLookupTable();
+    }
+
+    for (int type = 0; type < ImGuiMouseCursor_Count_; type++)
+        GImGui->MouseCursorData[type] = cursors[type];
+
+    return true;
+}
+
+bool SystemUI::SaveFontAtlas(unsigned key)
+{
+    if (fontAtlasCachePath_.Empty())
+        return false;
+
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    unsigned char* alpha;
+    int width, height;
+    atlas->GetTexDataAsAlpha8(&alpha, &width, &height);
+    if (alpha == nullptr)
+        return false;
+
+    GetSubsystem<FileSystem>()->CreateDir(GetPath(fontAtlasCachePath_));
+    File file(context_);
+    if (!file.Open(fontAtlasCachePath_, FILE_WRITE))
+        return false;
+
+    file.WriteFileID("FATL");
+    file.WriteUInt(FONT_ATLAS_CACHE_VERSION);
+    file.WriteUInt(key);
+    file.WriteVLE((unsigned)atlas->Fonts.Size);
+    file.WriteInt(width);
+    file.WriteInt(height);
+    file.WriteVector2({atlas->TexUvWhitePixel.x, atlas->TexUvWhitePixel.y});
+
+    // Mouse cursor shapes are stored in atlas as well, their coordinates are computed during build.
+    for (const ImGuiMouseCursorData& cursor : GImGui->MouseCursorData)
+    {
+        file.WriteVector2({cursor.HotOffset.x, cursor.HotOffset.y});
+        file.WriteVector2({cursor.Size.x, cursor.Size.y});
+        for (int i = 0; i < 2; i++)
+        {
+            file.WriteVector2({cursor.TexUvMin[i].x, cursor.TexUvMin[i].y});
+            file.WriteVector2({cursor.TexUvMax[i].x, cursor.TexUvMax[i].y});
+        }
+    }
+
+    for (const ImFont* font : atlas->Fonts)
+    {
+        file.WriteFloat(font->FontSize);
+        file.WriteFloat(font->Ascent);
+        file.WriteFloat(font->Descent);
+        file.WriteInt(font->MetricsTotalSurface);
+        file.WriteUShort(font->FallbackChar);
+        file.WriteVLE((unsigned)font->Glyphs.Size);
+        for (const ImFontGlyph& glyph : font->Glyphs)
+        {
+            file.WriteUShort(glyph.Codepoint);
+            file.WriteFloat(glyph.AdvanceX);
+            file.WriteFloat(glyph.X0);
+            file.WriteFloat(glyph.Y0);
+            file.WriteFloat(glyph.X1);
+            file.WriteFloat(glyph.Y1);
+            file.WriteFloat(glyph.U0);
+            file.WriteFloat(glyph.V0);
+            file.WriteFloat(glyph.U1);
+            file.WriteFloat(glyph.V1);
+        }
+    }
+
+    // Atlas is mostly empty space, it compresses well.
+    unsigned numPixels = (unsigned)(width * height);
+    SharedArrayPtr<unsigned char> compressed(new unsigned char[EstimateCompressBound(numPixels)]);
+    unsigned compressedSize = CompressData(compressed.Get(), alpha, numPixels);
+    file.WriteUInt(compressedSize);
+    return file.Write(compressed.Get(), compressedSize) == compressedSize;
+}
+
 void SystemUI::SetZoom(float zoom)
 {
     if (uiZoom_ == zoom)
@@ -365,17 +817,19 @@ void SystemUI::SetScale(Vector3 scale)
     io.DisplayFramebufferScale = {scale.x_, scale.y_};
     fontScale_ = scale.z_;
 
+    // Sizes are stored per added font, merged fonts included. Atlas is rebuilt before next frame.
     float prevSize = defaultFontSize;
-    for (auto i = 0; i < io.Fonts->Fonts.size(); i++)
+    for (auto i = 0; i < io.Fonts->ConfigData.size() && i < (int)fontSizes_.Size(); i++)
     {
         float sizePixels = fontSizes_[i];
         if (sizePixels == 0)
             sizePixels = prevSize;
         io.Fonts->ConfigData[i].SizePixels = sizePixels * fontScale_;
+        prevSize = sizePixels;
     }
 
-    if (io.Fonts->Fonts.size() > 0)
-        ReallocateFontTexture();
+    if (!io.Fonts->ConfigData.empty())
+        fontsDirty_ = true;
 }
 
 void SystemUI::ApplyStyleDefault(bool darkStyle, float alpha)
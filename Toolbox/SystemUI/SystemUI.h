@@ -29,6 +29,7 @@
 #include "Urho3D/Graphics/IndexBuffer.h"
 #include "Urho3D/Math/Matrix4.h"
 #include "Urho3D/Graphics/Texture2D.h"
+#include "Urho3D/Graphics/ShaderVariation.h"
 #include "SystemUIEvents.h"
 
 #include <imgui/imgui.h>
@@ -90,6 +91,22 @@ public:
     bool HasDragData() const { return dragData_.GetType() != VAR_NONE; }
     /// Return font scale.
     float GetFontScale() const { return fontScale_; }
+    /// Return number of render state changes issued when rendering last frame. Fixed pipeline state counts as one.
+    unsigned GetNumStateChanges() const { return numStateChanges_; }
+    /// Enable hashing of draw data, so that geometry is not uploaded again when it did not change since last frame.
+    void SetSkipUnchangedFrames(bool enable);
+    /// Return whether geometry is uploaded only when it changes.
+    bool GetSkipUnchangedFrames() const { return skipUnchangedFrames_; }
+    /// Return true if last frame of ui was identical to the one before it. Available only when skipping unchanged
+    /// frames is enabled. Application may use it for lowering frame rate while user is idle.
+    bool IsIdle() const { return numUnchangedFrames_ > 0; }
+    /// Return number of consecutive frames that were identical to the one before them.
+    unsigned GetNumUnchangedFrames() const { return numUnchangedFrames_; }
+    /// Set file storing rasterized font atlas between sessions. Atlas is rasterized again only when fonts, their sizes,
+    /// ranges or DPI scale change. Empty path disables caching.
+    void SetFontAtlasCachePath(const String& path) { fontAtlasCachePath_ = path; }
+    /// Return file storing rasterized font atlas between sessions.
+    const String& GetFontAtlasCachePath() const { return fontAtlasCachePath_; }
 
 protected:
     float uiZoom_ = 1.f;
@@ -100,10 +117,47 @@ protected:
     SharedPtr<Texture2D> fontTexture_;
     Variant dragData_;
     PODVector<float> fontSizes_;
+    /// Contents of font files keyed by resource name. Atlas refers to them without copying, they are released only
+    /// after ImGui is shut down. Values of HashMap are not moved when it grows.
+    HashMap<String, PODVector<unsigned char>> fontData_;
+    /// Glyph ranges of added fonts. Atlas refers to them whenever it is rebuilt.
+    Vector<SharedArrayPtr<unsigned short>> fontRanges_;
+    /// Vertex shader of untextured geometry.
+    SharedPtr<ShaderVariation> vertexColorVS_;
+    /// Pixel shader of untextured geometry.
+    SharedPtr<ShaderVariation> vertexColorPS_;
+    /// Vertex shader of textured geometry.
+    SharedPtr<ShaderVariation> diffMapVS_;
+    /// Pixel shader of textured geometry.
+    SharedPtr<ShaderVariation> diffMapPS_;
+    /// Pixel shader of geometry textured with alpha-only texture, used for fonts.
+    SharedPtr<ShaderVariation> alphaMapPS_;
+    /// Number of render state changes issued when rendering last frame.
+    unsigned numStateChanges_ = 0;
+    /// Flag indicating that geometry is uploaded only when it changes.
+    bool skipUnchangedFrames_ = false;
+    /// Hash of draw data uploaded last.
+    unsigned drawDataHash_ = 0;
+    /// Number of consecutive frames identical to the one before them.
+    unsigned numUnchangedFrames_ = 0;
+    /// Flag indicating that fonts were added or resized and atlas must be built before next frame.
+    bool fontsDirty_ = false;
+    /// File storing rasterized font atlas between sessions.
+    String fontAtlasCachePath_;
 
     void ReallocateFontTexture();
+    /// Return hash of everything that affects rasterized font atlas.
+    unsigned GetFontAtlasKey() const;
+    /// Restore rasterized font atlas from cache file. Return false if cache is missing or stale.
+    bool LoadFontAtlas(unsigned key);
+    /// Save rasterized font atlas to cache file.
+    bool SaveFontAtlas(unsigned key);
     void UpdateProjectionMatrix();
     void OnRenderDrawLists(ImDrawData* data);
+    /// Copy geometry of all draw lists to vertex and index buffers. When rebaseIndices is set, first vertex of every
+    /// draw list is added to it's indices, for renderers that do not support base vertex index. Return false if buffers
+    /// could not be locked.
+    bool UploadDrawData(ImDrawData* data, bool rebaseIndices);
     void OnRawEvent(VariantMap& args);
     void OnUpdate();
 };
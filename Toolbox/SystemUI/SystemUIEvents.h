@@ -48,6 +48,18 @@ URHO3D_EVENT(E_ATTRIBUTEINSPECTVALUEMODIFIED, AttributeInspectorValueModified)
     URHO3D_PARAM(P_NEWVALUE, NewValue);                          // Variant
 }
 
+/// Sent before E_ATTRIBUTEINSPECTVALUEMODIFIED events of a modification applied to multiple items at once.
+URHO3D_EVENT(E_ATTRIBUTEINSPECTBATCHBEGIN, AttributeInspectorBatchBegin)
+{
+
+}
+
+/// Sent after E_ATTRIBUTEINSPECTVALUEMODIFIED events of a modification applied to multiple items at once.
+URHO3D_EVENT(E_ATTRIBUTEINSPECTBATCHEND, AttributeInspectorBatchEnd)
+{
+
+}
+
 URHO3D_EVENT(E_ATTRIBUTEINSPECTOATTRIBUTE, AttributeInspectorAttribute)
 {
     URHO3D_PARAM(P_SERIALIZABLE, Serializable);                  // Serializable pointer
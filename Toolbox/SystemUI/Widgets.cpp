@@ -32,90 +32,261 @@ using namespace Urho3D;
 namespace ImGui
 {
 
-const unsigned UISTATE_EXPIRATION_MS = 30000;
+/// Number of frames state may remain unused before it expires.
+const int UISTATE_EXPIRATION_FRAMES = 1800;
+/// Number of state slots checked for expiration every frame.
+const unsigned UISTATE_SWEEP_STEP = 32;
+/// Maximum number of windows, innermost first, whose expiration expires a state.
+const unsigned UISTATE_MAX_OWNERS = 8;
+
+/// Identifies ui state by position in id stack and type of state object.
+struct UIStateKey
+{
+    /// Test for equality with another key.
+    bool operator ==(const UIStateKey& rhs) const { return id_ == rhs.id_ && type_ == rhs.type_; }
+    /// Test for inequality with another key.
+    bool operator !=(const UIStateKey& rhs) const { return !(*this == rhs); }
+    /// Return hash value for HashMap.
+    unsigned ToHash() const { return id_ ^ ((unsigned)((size_t)type_ >> 3) * 31); }
+
+    /// Top of id stack at the time state was stored.
+    ImGuiID id_;
+    /// Unique identifier of state type.
+    const void* type_;
+};
+
+/// Storage of a single ui state object.
+struct UIStateSlot
+{
+    /// User state pointer.
+    void* state_ = nullptr;
+    /// Function that handles deleting state object when it becomes unused.
+    void(*deleter_)(void* state) = nullptr;
+    /// Key of the state within it's window.
+    UIStateKey key_{0, nullptr};
+    /// Window state was stored in.
+    ImGuiID window_ = 0;
+    /// Window state was stored in followed by it's parent windows. Expiring any of them expires the state.
+    ImGuiID owners_[UISTATE_MAX_OWNERS]{};
+    /// Generations of owner windows at the time state was stored. State is stale when any of them differs.
+    unsigned ownerGenerations_[UISTATE_MAX_OWNERS]{};
+    /// Number of owner windows.
+    unsigned numOwners_ = 0;
+    /// Frame number when state was used last time.
+    int lastFrame_ = 0;
+    /// Flag indicating that slot holds a state.
+    bool used_ = false;
+};
 
-struct UIStateWrapper
+/// States stored in a single window.
+struct UIStatePartition
 {
-    void Set(void* state, void(*deleter)(void*)=nullptr)
+    /// Slot indices keyed by id stack position and type.
+    HashMap<UIStateKey, unsigned> slots_;
+};
+
+/// Ui states stored in reusable slots, partitioned by window. Unused states are swept incrementally, a few slots every
+/// frame. Every state records the window it was stored in and it's parent windows along with their generations.
+/// States of a whole window and it's child windows are expired by bumping generation of that window.
+class UIStateStore
+{
+public:
+    /// Return state stored at specified key of a window.
+    void* Get(ImGuiWindow* window, const UIStateKey& key)
     {
-        state_ = state;
-        deleter_ = deleter;
+        Sweep();
+
+        auto partitionIt = partitions_.Find(window->ID);
+        if (partitionIt == partitions_.End())
+            return nullptr;
+
+        auto it = partitionIt->second_.slots_.Find(key);
+        if (it == partitionIt->second_.slots_.End())
+            return nullptr;
+
+        UIStateSlot& slot = slots_[it->second_];
+        if (IsStale(slot))
+            return nullptr;
+
+        slot.lastFrame_ = ImGui::GetFrameCount();
+        return slot.state_;
     }
 
-    void Unset()
+    /// Store state at specified key of a window. Previously stored different state is freed.
+    void Set(ImGuiWindow* window, const UIStateKey& key, void* state, void(*deleter)(void*))
     {
-        if (deleter_ && state_)
-            deleter_(state_);
-        state_ = nullptr;
-        deleter_ = nullptr;
+        UIStatePartition& partition = partitions_[window->ID];
+
+        auto it = partition.slots_.Find(key);
+        if (it != partition.slots_.End())
+        {
+            UIStateSlot& slot = slots_[it->second_];
+            if (slot.state_ == state && !IsStale(slot))
+            {
+                slot.deleter_ = deleter;
+                slot.lastFrame_ = ImGui::GetFrameCount();
+                return;
+            }
+            Free(it->second_);
+        }
+
+        unsigned index;
+        if (freeSlots_.Empty())
+        {
+            index = slots_.Size();
+            slots_.Resize(index + 1);
+        }
+        else
+        {
+            index = freeSlots_.Back();
+            freeSlots_.Pop();
+        }
+
+        // Partition reference is still valid, Free() never erases partition of a window which is being stored into.
+        UIStateSlot& slot = slots_[index];
+        slot.state_ = state;
+        slot.deleter_ = deleter;
+        slot.key_ = key;
+        slot.window_ = window->ID;
+        slot.numOwners_ = 0;
+        for (ImGuiWindow* owner = window; owner != nullptr && slot.numOwners_ < UISTATE_MAX_OWNERS;
+            owner = (owner->Flags & ImGuiWindowFlags_ChildWindow) ? owner->ParentWindow : nullptr)
+        {
+            slot.owners_[slot.numOwners_] = owner->ID;
+            slot.ownerGenerations_[slot.numOwners_] = GetGeneration(owner->ID);
+            slot.numOwners_++;
+        }
+        slot.lastFrame_ = ImGui::GetFrameCount();
+        slot.used_ = true;
+        partition.slots_[key] = index;
     }
 
-    void* Get(bool keepAlive=true)
+    /// Free state stored at specified key of a window.
+    void Expire(ImGuiWindow* window, const UIStateKey& key)
     {
-        if (keepAlive)
-            timer_.Reset();
-        return state_;
+        auto partitionIt = partitions_.Find(window->ID);
+        if (partitionIt == partitions_.End())
+            return;
+
+        auto it = partitionIt->second_.slots_.Find(key);
+        if (it != partitionIt->second_.slots_.End())
+            Free(it->second_);
     }
 
-    bool IsExpired()
+    /// Expire all states of a window and it's child windows. States are not visited, they are freed by sweeping.
+    void ExpireWindow(ImGuiID windowId)
     {
-        return timer_.GetMSec(false) >= UISTATE_EXPIRATION_MS;
+        generations_[windowId]++;
     }
 
-protected:
-    /// User state pointer.
-    void* state_ = nullptr;
-    /// Function that handles deleting state object when it becomes unused.
-    void(*deleter_)(void* state) = nullptr;
-    /// Timer which determines when state expires.
-    Timer timer_;
-};
+private:
+    /// Return generation of a window.
+    unsigned GetGeneration(ImGuiID windowId) const
+    {
+        auto it = generations_.Find(windowId);
+        return it != generations_.End() ? it->second_ : 0;
+    }
 
-HashMap<ImGuiID, UIStateWrapper> uiState_;
+    /// Return true if window state was stored in or any of it's parent windows expired since.
+    bool IsStale(const UIStateSlot& slot) const
+    {
+        // Windows are rarely expired, most of the time there is nothing to compare.
+        if (generations_.Empty())
+            return false;
+        for (unsigned i = 0; i < slot.numOwners_; i++)
+        {
+            if (GetGeneration(slot.owners_[i]) != slot.ownerGenerations_[i])
+                return true;
+        }
+        return false;
+    }
 
-void SetUIStateP(void* state, void(*deleter)(void*))
-{
-    auto id = ui::GetCurrentWindow()->IDStack.back();
-    uiState_[id].Set(state, deleter);
-}
+    /// Free state in specified slot and make slot available for reuse.
+    void Free(unsigned index)
+    {
+        UIStateSlot& slot = slots_[index];
+        auto partitionIt = partitions_.Find(slot.window_);
+        if (partitionIt != partitions_.End())
+        {
+            HashMap<UIStateKey, unsigned>& partitionSlots = partitionIt->second_.slots_;
+            auto it = partitionSlots.Find(slot.key_);
+            if (it != partitionSlots.End() && it->second_ == index)
+                partitionSlots.Erase(it);
+        }
 
-void* GetUIStateP()
-{
-    void* result = nullptr;
-    auto id = ui::GetCurrentWindow()->IDStack.back();
-    auto it = uiState_.Find(id);
-    if (it != uiState_.End())
-        result = it->second_.Get();
-
-    // Every 30s check all saved states and remove expired ones.
-    static Timer gcTimer;
-    if (gcTimer.GetMSec(false) > UISTATE_EXPIRATION_MS)
+        if (slot.deleter_ && slot.state_)
+            slot.deleter_(slot.state_);
+        slot = UIStateSlot();
+        freeSlots_.Push(index);
+    }
+
+    /// Check a few slots and free states that were not used for a while or whose window expired. Runs once per frame.
+    void Sweep()
     {
-        gcTimer.Reset();
+        int frame = ImGui::GetFrameCount();
+        if (frame == lastSweepFrame_)
+            return;
+        lastSweepFrame_ = frame;
 
-        for (auto jt = uiState_.Begin(); jt != uiState_.End();)
+        for (unsigned i = 0; i < UISTATE_SWEEP_STEP && i < slots_.Size(); i++)
         {
-            if (jt->second_.IsExpired())
+            if (sweepCursor_ >= slots_.Size())
+                sweepCursor_ = 0;
+            unsigned index = sweepCursor_++;
+
+            const UIStateSlot& slot = slots_[index];
+            if (!slot.used_)
+                continue;
+
+            auto partitionIt = partitions_.Find(slot.window_);
+            bool stale = partitionIt == partitions_.End() || IsStale(slot);
+            if (stale || frame - slot.lastFrame_ >= UISTATE_EXPIRATION_FRAMES)
             {
-                jt->second_.Unset();
-                jt = uiState_.Erase(jt);
+                Free(index);
+                // Window without states does not need a partition.
+                if (partitionIt != partitions_.End() && partitionIt->second_.slots_.Empty())
+                    partitions_.Erase(partitionIt);
             }
-            else
-                ++jt;
         }
     }
 
-    return result;
+    /// State slots, some of them unused.
+    Vector<UIStateSlot> slots_;
+    /// Indices of unused slots.
+    PODVector<unsigned> freeSlots_;
+    /// States of every window.
+    HashMap<ImGuiID, UIStatePartition> partitions_;
+    /// Generations of windows that were expired at least once.
+    HashMap<ImGuiID, unsigned> generations_;
+    /// Index of next slot checked for expiration.
+    unsigned sweepCursor_ = 0;
+    /// Frame number of last sweep.
+    int lastSweepFrame_ = -1;
+};
+
+UIStateStore uiState_;
+
+void SetUIStateP(void* state, void(*deleter)(void*), const void* type)
+{
+    auto window = ui::GetCurrentWindow();
+    uiState_.Set(window, {window->IDStack.back(), type}, state, deleter);
+}
+
+void* GetUIStateP(const void* type)
+{
+    auto window = ui::GetCurrentWindow();
+    return uiState_.Get(window, {window->IDStack.back(), type});
 }
 
-void ExpireUIStateP()
+void ExpireUIStateP(const void* type)
 {
-    auto it = uiState_.Find(ui::GetCurrentWindow()->IDStack.back());
-    if (it != uiState_.End())
-    {
-        it->second_.Unset();
-        uiState_.Erase(it);
-    }
+    auto window = ui::GetCurrentWindow();
+    uiState_.Expire(window, {window->IDStack.back(), type});
+}
+
+void ExpireUIStateWindow(ImGuiID windowId)
+{
+    uiState_.ExpireWindow(windowId);
 }
 
 int DoubleClickSelectable(const char* label, bool* p_selected, ImGuiSelectableFlags flags, const ImVec2& size)
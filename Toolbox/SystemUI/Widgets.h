@@ -23,7 +23,6 @@
 #pragma once
 
 
-#include <typeinfo>
 #include <imgui/imgui.h>
 #include <Urho3D/Math/Rect.h>
 #include <Toolbox/Utils.h>
@@ -43,37 +42,44 @@ enum TransformSelectorFlags
 
 URHO3D_TO_FLAGS_ENUM(TransformSelectorFlags);
 
+/// Return unique identifier of type T, used for telling apart ui states of different types. Does not depend on RTTI.
+/// Identifier is address of writable data, because identical constants of different instantiations may be folded by
+/// linker.
+template<typename T>
+const void* GetUIStateType()
+{
+    static char id;
+    return &id;
+}
 /// Set custom user pointer storing UI state at given position of id stack. Optionally pass deleter function which is
-/// responsible for freeing state object when it is no longer used.
-void SetUIStateP(void* state, void(* deleter)(void*) = nullptr);
-/// Get custom user pointer storing UI state at given position of id stack. If this function is not called for 30s or
-/// longer then state will expire and will be removed.
-void* GetUIStateP();
+/// responsible for freeing state object when it is no longer used and identifier of state type.
+void SetUIStateP(void* state, void(* deleter)(void*) = nullptr, const void* type = nullptr);
+/// Get custom user pointer storing UI state at given position of id stack. If state is not retrieved for a number of
+/// frames then state will expire and will be removed.
+void* GetUIStateP(const void* type = nullptr);
 /// Expire custom ui state at given position if id stack, created with SetUIStateP(). It will be freed immediately.
-void ExpireUIStateP();
+void ExpireUIStateP(const void* type = nullptr);
+/// Expire all ui states stored in specified window and it's child windows. They are freed during following frames.
+void ExpireUIStateWindow(ImGuiID windowId);
 /// Get custom user iu state at given position of id stack. If state does not exist then state object will be created.
 /// Using different type at the same id stack position will return new object of that type. Arguments passed to this
 /// function will be passed to constructor of type T.
 template<typename T, typename... Args>
 T* GetUIState(Args... args)
 {
-    ImGui::PushID(typeid(T).name());
-    T* state = (T*)GetUIStateP();
+    T* state = (T*)GetUIStateP(GetUIStateType<T>());
     if (state == nullptr)
     {
         state = new T(args...);
-        SetUIStateP(state, [](void* s) { delete (T*)s; });
+        SetUIStateP(state, [](void* s) { delete (T*)s; }, GetUIStateType<T>());
     }
-    ImGui::PopID();
     return state;
 }
 /// Expire custom ui state at given position if id stack, created with GetUIState<T>. It will be freed immediately.
 template<typename T>
 void ExpireUIState()
 {
-    ImGui::PushID(typeid(T).name());
-    ExpireUIStateP();
-    ImGui::PopID();
+    ExpireUIStateP(GetUIStateType<T>());
 }
 /// Same as Selectable(), except returns 1 when clicked once, 2 when double-clicked, 0 otherwise.
 int DoubleClickSelectable(const char* label, bool* p_selected, ImGuiSelectableFlags flags = 0, const ImVec2& size = ImVec2(0,0));
@@ -25,6 +25,14 @@
 #include "SystemUI/AttributeInspector.h"
 #include "Scene/DebugCameraController.h"
 #include "Common/UndoManager.h"
+#include "Common/UndoJournal.h"
+#include "IO/ResourceDependencyGraph.h"
+#include "IO/ResourceDirectoryIndex.h"
+#include "IO/ResourcePreloader.h"
+#include "IO/ResourceSaver.h"
+#include "IO/ResourceSearchIndex.h"
+#include "Graphics/PreviewRenderer.h"
+#include "Graphics/ThumbnailService.h"
 
 
 namespace Urho3D
@@ -37,6 +45,14 @@ void RegisterToolboxTypes(Context* context)
     context->RegisterFactory<AttributeInspectorWindow>();
     context->RegisterFactory<DebugCameraController>();
     context->RegisterFactory<Undo::Manager>();
+    context->RegisterFactory<Undo::Journal>();
+    context->RegisterFactory<ResourceDirectoryIndex>();
+    context->RegisterFactory<ResourceSearchIndex>();
+    context->RegisterFactory<ResourceDependencyGraph>();
+    context->RegisterFactory<ResourcePreloader>();
+    context->RegisterFactory<ResourceSaver>();
+    context->RegisterFactory<ThumbnailService>();
+    context->RegisterFactory<PreviewRenderer>();
 }
 
 };